@@ -0,0 +1,246 @@
+#include "FitsConverter.h"
+#include "Benchmark.h"
+#include "SyntheticFits.h"
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <map>
+#include <mutex>
+
+
+//google benchmark suite of the conversion stages on synthetic data. every benchmark reports pixels/s as items_per_second
+//and the bytes it reads or writes as bytes_per_second, per second of wall time for the io benchmarks;
+//run with --benchmark_filter to pick stages or sizes
+namespace FitsConverter {
+
+	constexpr ColorizeMode benchmarkModes[] = { ColorizeMode::GREYSCALE, ColorizeMode::ROYGBIV, ColorizeMode::NICKRGB, ColorizeMode::BINARY, ColorizeMode::SHORTNRGB };
+
+	//makeSyntheticImage of side x side pixels and its stats, made once per side for the whole run
+	struct SyntheticImage {
+
+		std::vector<float> pixels;
+		ImageStats stats;
+	};
+
+	const SyntheticImage& syntheticImage(std::size_t side) {
+
+		static std::mutex mutex;
+		static std::map<std::size_t, SyntheticImage> images;
+
+		std::scoped_lock lock(mutex);
+
+		auto [it, added] = images.try_emplace(side);
+		if (added) {
+			it->second.pixels = makeSyntheticImage(side, side);
+			it->second.stats = computeImageStats(it->second.pixels);
+		}
+		return it->second;
+	}
+
+	std::filesystem::path benchmarkPath(const std::string& name) {
+
+		return std::filesystem::temp_directory_path() / ("fitsconverter_benchmark_" + name);
+	}
+
+	//a single HDU synthetic sky of side x side pixels stored as bitpix, written once per run and removed at exit
+	const std::string& syntheticFitsFile(int bitpix, std::size_t side) {
+
+		struct Files {
+
+			std::map<std::pair<int, std::size_t>, std::string> names;
+			~Files() {
+				for (auto& [key, name] : names)
+					std::filesystem::remove(name);
+			}
+		};
+		static std::mutex mutex;
+		static Files files;
+
+		std::scoped_lock lock(mutex);
+
+		auto [it, added] = files.names.try_emplace({ bitpix, side });
+		if (!added) return it->second;
+
+		it->second = benchmarkPath(std::format("{}_{}.fits", bitpix, side)).string();
+
+		SyntheticFitsSpec spec;
+		spec.width = spec.height = side;
+		spec.bitpix = bitpix;
+		writeSyntheticFits(it->second, spec);
+
+		return it->second;
+	}
+
+	void setThroughput(benchmark::State& state, std::size_t pixels, std::size_t bytes) {
+
+		state.SetItemsProcessed(state.iterations() * pixels);
+		state.SetBytesProcessed(state.iterations() * bytes);
+	}
+
+	//args: colorize mode, stripes, image side
+	void BM_floatSpaceConvert(benchmark::State& state) {
+
+		auto colorMode = benchmarkModes[state.range(0)];
+		auto stripeNum = state.range(1);
+		auto& image = syntheticImage(state.range(2));
+
+		std::vector<std::uint32_t> converted(image.pixels.size());
+
+		for (auto _ : state) {
+
+			floatSpaceConvert(image.pixels, converted, image.stats, colorMode, 0.0, 1.0, stripeNum);
+			benchmark::DoNotOptimize(converted.data());
+			benchmark::ClobberMemory();
+		}
+
+		state.SetLabel(std::format("{} stripes {} {}", colorizeModeStr(colorMode), stripeNum, simdLevelStr(activeSimdLevel())));
+		setThroughput(state, image.pixels.size(), image.pixels.size() * (sizeof(float) + sizeof(std::uint32_t)));
+	}
+	BENCHMARK(BM_floatSpaceConvert)
+		->ArgNames({ "mode", "stripes", "side" })
+		->ArgsProduct({ benchmark::CreateDenseRange(0, std::size(benchmarkModes) - 1, 1), { 1, 10, 100 }, { 256, 1024, 4096, 16384 } })
+		->Unit(benchmark::kMillisecond);
+
+	//one colorize lambda alone over percents spread evenly through 0 .. 1, without the stripe arithmetic or the stores
+	template<typename Colorize>
+	void BM_colorizeLambda(benchmark::State& state, Colorize colorize) {
+
+		std::vector<double> percents(1 << 16);
+		for (std::size_t i = 0; i < percents.size(); ++i)
+			percents[i] = double(i) / (percents.size() - 1);
+
+		for (auto _ : state)
+			for (auto percent : percents)
+				benchmark::DoNotOptimize(colorize(percent));
+
+		setThroughput(state, percents.size(), percents.size() * sizeof(double));
+	}
+	BENCHMARK_CAPTURE(BM_colorizeLambda, nrgb, nrgb);
+	BENCHMARK_CAPTURE(BM_colorizeLambda, snrgb, snrgb);
+	BENCHMARK_CAPTURE(BM_colorizeLambda, roygbiv, roygbiv);
+	BENCHMARK_CAPTURE(BM_colorizeLambda, grayScale, grayScale);
+	BENCHMARK_CAPTURE(BM_colorizeLambda, binary, binary);
+
+	//args: bitpix, image side. the whole HDU as floats, as the float path reads it; bytes are those stored in the file
+	void BM_readImage(benchmark::State& state) {
+
+		int bitpix = int(state.range(0));
+		std::size_t side = state.range(1);
+		auto& fileName = syntheticFitsFile(bitpix, side);
+
+		fitsfile* fptr;
+		int status = 0;
+		if (fits_open_file(&fptr, fileName.c_str(), READONLY, &status))
+			throw std::runtime_error("failed to open fits");
+
+		std::vector<float> image;
+		for (auto _ : state) {
+
+			readImage(fptr, side * side, image);
+			benchmark::DoNotOptimize(image.data());
+		}
+
+		fits_close_file(fptr, &status);
+		setThroughput(state, side * side, side * side * std::abs(bitpix) / 8);
+	}
+	BENCHMARK(BM_readImage)
+		->ArgNames({ "bitpix", "side" })
+		->ArgsProduct({ { BYTE_IMG, SHORT_IMG, LONG_IMG, FLOAT_IMG, DOUBLE_IMG }, { 1024, 4096 } })
+		->Unit(benchmark::kMillisecond)->UseRealTime();
+
+	//args: bitpix, image side. BITPIX 8 and 16 read as raw indices, as the native integer path reads them
+	void BM_readIndexedImage(benchmark::State& state) {
+
+		int bitpix = int(state.range(0));
+		std::size_t side = state.range(1);
+		auto& fileName = syntheticFitsFile(bitpix, side);
+
+		fitsfile* fptr;
+		int status = 0;
+		if (fits_open_file(&fptr, fileName.c_str(), READONLY, &status))
+			throw std::runtime_error("failed to open fits");
+
+		for (auto _ : state)
+			benchmark::DoNotOptimize(readIndexedImage(fptr, bitpix, side * side));
+
+		fits_close_file(fptr, &status);
+		setThroughput(state, side * side, side * side * std::abs(bitpix) / 8);
+	}
+	BENCHMARK(BM_readIndexedImage)
+		->ArgNames({ "bitpix", "side" })
+		->ArgsProduct({ { BYTE_IMG, SHORT_IMG }, { 1024, 4096 } })
+		->Unit(benchmark::kMillisecond)->UseRealTime();
+
+	//args: pixel format, image side. the colorized roygbiv, greyscale or binary image written by the built in bmp writer
+	void BM_writeBmpFile(benchmark::State& state) {
+
+		auto format = PixelFormat(state.range(0));
+		std::size_t side = state.range(1);
+		auto& image = syntheticImage(side);
+
+		auto colorMode = format == PixelFormat::BIT1 ? ColorizeMode::BINARY : format == PixelFormat::GREY8 ? ColorizeMode::GREYSCALE : ColorizeMode::ROYGBIV;
+		std::vector<std::uint8_t> rows(pixelFormatRowBytes(format, side) * side);
+
+		if (format == PixelFormat::COLOR32)
+			floatSpaceConvert<bmpChannelOrder>(image.pixels, std::span(reinterpret_cast<std::uint32_t*>(rows.data()), image.pixels.size()), image.stats, colorMode);
+		else
+			packSpaceConvert(std::span<const float>(image.pixels), side, std::vector<PackedVariant>{ { colorMode, 1, rows } }, image.stats);
+
+		auto fileName = benchmarkPath(std::format("{}_{}.bmp", state.range(0), side)).string();
+
+		for (auto _ : state)
+			writeBmpFile(fileName, side, side, rows, format);
+
+		setThroughput(state, side * side, std::filesystem::file_size(fileName));
+		std::filesystem::remove(fileName);
+	}
+	BENCHMARK(BM_writeBmpFile)
+		->ArgNames({ "format", "side" })
+		->ArgsProduct({ { int(PixelFormat::COLOR32), int(PixelFormat::GREY8), int(PixelFormat::BIT1) }, { 1024, 4096 } })
+		->Unit(benchmark::kMillisecond)->UseRealTime();
+
+	//args: image side. a 32 bit roygbiv image saved through FreeImage from a pooled FIBITMAP, the path of --freeimage
+	void BM_freeImageSave(benchmark::State& state) {
+
+		std::size_t side = state.range(0);
+		auto& image = syntheticImage(side);
+
+		auto bitmap = bitmapPool().acquire(side, side);
+		floatSpaceConvert<bmpChannelOrder>(image.pixels, bitmap.pixels(), image.stats, ColorizeMode::ROYGBIV);
+
+		auto fileName = benchmarkPath(std::format("freeimage_{}.bmp", side)).string();
+
+		for (auto _ : state)
+			FreeImage_Save(FIF_BMP, bitmap.get(), fileName.c_str(), 0);
+
+		setThroughput(state, side * side, std::filesystem::file_size(fileName));
+		std::filesystem::remove(fileName);
+	}
+	BENCHMARK(BM_freeImageSave)->ArgName("side")->Arg(1024)->Arg(4096)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+	//args: zlib level, image side. a 32 bit roygbiv png, deflated in strips on the default pool
+	void BM_writePngFile(benchmark::State& state) {
+
+		int level = int(state.range(0));
+		std::size_t side = state.range(1);
+		auto& image = syntheticImage(side);
+
+		std::vector<std::uint32_t> converted(image.pixels.size());
+		floatSpaceConvert<pngChannelOrder>(image.pixels, converted, image.stats, ColorizeMode::ROYGBIV);
+
+		auto fileName = benchmarkPath(std::format("{}_{}.png", level, side)).string();
+
+		for (auto _ : state)
+			writePngFile(fileName, side, side, converted, defaultThreadPool(), level);
+
+		setThroughput(state, side * side, std::filesystem::file_size(fileName));
+		std::filesystem::remove(fileName);
+	}
+	BENCHMARK(BM_writePngFile)
+		->ArgNames({ "level", "side" })
+		->ArgsProduct({ { 1, 6 }, { 1024, 4096 } })
+		->Unit(benchmark::kMillisecond)->UseRealTime();
+};
+
+BENCHMARK_MAIN();
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "FitsConverter.h"
+#include "ThreadPool.h"
+#include "IoGate.h"
+
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <chrono>
+#include <string>
+#include <span>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <cctype>
+#include <thread>
+#include <memory>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <format>
+
+
+namespace FitsConverter {
+
+	struct BatchOptions {
+
+		//files converted at once, each on a worker of the shared pool and never more than it has workers; their HDU work runs on the same workers.
+		//a memory budget of the job applies to every one of them. the files are converted without prefetch or HDU threads,
+		//which would run threads of their own outside the pool
+		std::size_t fileThreads = 4;
+
+		//fits reads in progress at once, across all files
+		std::size_t maxReads = 2;
+
+		//output files being written at once, across all files
+		std::size_t maxWrites = 4;
+
+		//workers of the pool shared by every file; 0 uses one per hardware thread. ignored when the job brings its own threadPool
+		std::size_t cpuThreads = 0;
+
+		//take the fits files of subdirectories of directory inputs as well
+		bool recursive = false;
+	};
+
+	struct BatchFailure {
+
+		std::string fileName, error;
+	};
+
+	struct BatchReport {
+
+		std::size_t files = 0, hdus = 0, pixels = 0, outputs = 0;
+		std::vector<BatchFailure> failures;
+		double seconds = 0.0;
+
+		//fits pixels converted per second of wall time, each to every output of the job
+		double megaPixelsPerSecond() const { return seconds > 0.0 ? pixels / 1e6 / seconds : 0.0; }
+	};
+
+	bool isFitsFileName(const std::filesystem::path& path) {
+
+		auto extension = path.extension().string();
+		std::ranges::transform(extension, extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+
+		return extension == ".fits" || extension == ".fit" || extension == ".fts" || extension == ".fz";
+	}
+
+	//the fits files named by inputs: directories give their fits files in name order, @file gives the paths listed in file,
+	//one per line, and any other input is taken as a fits file. a file named twice is converted once
+	std::vector<std::string> collectFitsFiles(std::span<const std::string> inputs, bool recursive = false) {
+
+		std::vector<std::string> files;
+
+		for (auto& input : inputs) {
+
+			if (input.starts_with("@")) {
+
+				std::ifstream list(input.substr(1));
+				if (!list)
+					throw std::runtime_error(std::format("failed to open file list {}", input.substr(1)));
+
+				for (std::string line; std::getline(list, line); ) {
+
+					if (!line.empty() && line.back() == '\r') line.pop_back();
+					if (!line.empty()) files.push_back(line);
+				}
+
+			} else if (std::filesystem::is_directory(input)) {
+
+				std::vector<std::string> directoryFiles;
+				auto addFile = [&](const std::filesystem::directory_entry& entry) {
+					if (entry.is_regular_file() && isFitsFileName(entry.path()))
+						directoryFiles.push_back(entry.path().string());
+				};
+
+				if (recursive)
+					for (auto& entry : std::filesystem::recursive_directory_iterator(input)) addFile(entry);
+				else
+					for (auto& entry : std::filesystem::directory_iterator(input)) addFile(entry);
+
+				std::ranges::sort(directoryFiles);
+				files.insert(files.end(), directoryFiles.begin(), directoryFiles.end());
+
+			} else
+				files.push_back(input);
+		}
+
+		std::set<std::string> seen;
+		std::erase_if(files, [&](const std::string& file) { return !seen.insert(std::filesystem::path(file).lexically_normal().string()).second; });
+
+		return files;
+	}
+
+	//converts every file with the outputs and options of job, fileThreads files at a time on the workers of one shared pool.
+	//the largest files start first, so the small ones fill the workers at the end instead of a large one running alone.
+	//a file that fails is reported and the batch goes on
+	BatchReport runBatch(std::span<const std::string> files, const ConversionJob& job, const BatchOptions& batch = {}) {
+
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<std::pair<std::uintmax_t, std::string>> bySize;
+		for (auto& file : files) {
+
+			std::error_code error;
+			auto size = std::filesystem::file_size(file, error);
+			bySize.emplace_back(error ? 0 : size, file);
+		}
+		std::ranges::stable_sort(bySize, std::greater<>(), [](auto& file) { return file.first; });
+
+		std::unique_ptr<ThreadPool> ownPool;
+		if (!job.options.threadPool)
+			ownPool = std::make_unique<ThreadPool>(batch.cpuThreads ? batch.cpuThreads : std::thread::hardware_concurrency());
+
+		IoGate reads(batch.maxReads), writes(batch.maxWrites);
+
+		ConversionJob fileJob = job;
+		fileJob.options.threadPool = job.options.threadPool ? job.options.threadPool : ownPool.get();
+		fileJob.options.readGate = &reads;
+		fileJob.options.writeGate = &writes;
+
+		//prefetch and HDU threads would add reader and converter threads to every file beside the pool's workers
+		fileJob.options.prefetchDepth = 0;
+		fileJob.options.hduThreads = 1;
+
+		auto& pool = *fileJob.options.threadPool;
+
+		BatchReport report;
+		std::mutex reportMutex;
+		std::atomic<std::size_t> next = 0;
+
+		//each runner converts the next file until none are left. runners are root tasks, so a worker waiting on the bands of
+		//its file never takes up another file, and there are never more of them than workers
+		std::size_t runners = std::min({ std::max<std::size_t>(batch.fileThreads, 1), pool.size(), bySize.size() });
+
+		std::mutex runnersMutex;
+		std::condition_variable runnersDone;
+		std::size_t running = runners;
+
+		for (std::size_t r = 0; r < runners; ++r)
+			pool.submitRoot([&]() {
+
+				auto fileTask = fileJob;
+
+				for (std::size_t i; (i = next++) < bySize.size(); ) {
+
+					fileTask.fileName = bySize[i].second;
+
+					try {
+						auto result = runConversionJob(fileTask);
+
+						std::scoped_lock lock(reportMutex);
+						++report.files;
+						report.hdus += result.hdus;
+						report.pixels += result.pixels;
+						report.outputs += result.outputs;
+					}
+					catch (const std::exception& error) {
+
+						std::scoped_lock lock(reportMutex);
+						report.failures.push_back({ fileTask.fileName, error.what() });
+					}
+
+					//buffers and bitmaps sized for the HDUs of one file are rarely the sizes of the next
+					BufferPool::trim();
+					if (fileTask.options.freeImageBmp) bitmapPool().trim();
+				}
+
+				std::scoped_lock lock(runnersMutex);
+				if (--running == 0) runnersDone.notify_all();
+				});
+
+		//the calling thread only sleeps, unless it is a worker of the pool itself, whose runners might otherwise wait on it
+		while (true) {
+
+			if (pool.isWorkerThread() && pool.runPendingTask(true)) continue;
+
+			std::unique_lock lock(runnersMutex);
+			if (runnersDone.wait_for(lock, std::chrono::milliseconds(1), [&]() { return running == 0; })) break;
+		}
+
+		report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return report;
+	}
+
+	void printBatchReport(const BatchReport& report, std::ostream& out) {
+
+		for (auto& failure : report.failures)
+			out << std::format("failed: {}: {}\n", failure.fileName, failure.error);
+
+		out << std::format("{} files converted, {} failed: {} HDUs, {:.1f} MPix to {} outputs in {:.2f} s, {:.1f} MPix/s\n",
+			report.files, report.failures.size(), report.hdus, report.pixels / 1e6, report.outputs, report.seconds, report.megaPixelsPerSecond());
+	}
+};
@@ -0,0 +1,289 @@
+#pragma once
+
+#include "FitsConverter.h"
+#include "SyntheticFits.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <numeric>
+#include <functional>
+#include <future>
+#include <filesystem>
+
+namespace FitsConverter {
+
+	//a noisy gradient, so that every stripe count crosses all of the roygbiv bands
+	std::vector<float> makeSyntheticImage(std::size_t width, std::size_t height, unsigned seed = 1) {
+
+		std::vector<float> image(width * height);
+
+		std::mt19937 random(seed);
+		std::normal_distribution<float> noise(0.0f, 0.05f);
+
+		for (std::size_t y = 0; y < height; ++y)
+			for (std::size_t x = 0; x < width; ++x)
+				image[y * width + x] = float(x + y) / (width + height) + noise(random);
+
+		return image;
+	}
+
+	//best of several runs, in milliseconds
+	template<typename Function>
+	double timeMilliseconds(Function&& function, std::size_t repeats = 3) {
+
+		double best = std::numeric_limits<double>::max();
+
+		for (std::size_t i = 0; i < repeats; ++i) {
+
+			auto start = std::chrono::steady_clock::now();
+			function();
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+			best = std::min(best, elapsed.count());
+		}
+		return best;
+	}
+
+	//compares the constexpr colorize tables with the colorize lambdas on one synthetic image
+	void benchmarkColorizeLut(std::size_t width = 4096, std::size_t height = 4096) {
+
+		auto image = makeSyntheticImage(width, height);
+		auto stats = computeImageStats(image);
+
+		std::vector<uint32_t> reference(image.size()), converted(image.size());
+
+		auto colorizeModes = { ColorizeMode::GREYSCALE, ColorizeMode::ROYGBIV, ColorizeMode::NICKRGB, ColorizeMode::BINARY, ColorizeMode::SHORTNRGB };
+		auto stripes = { 1, 100 };
+
+		double megaPixels = image.size() / 1e6;
+
+		std::cout << std::format("colorize lut benchmark, {}x{} pixels\n", width, height);
+
+		for (auto colorizeMode : colorizeModes)
+			for (auto stripeNum : stripes) {
+
+				auto lambdaMs = timeMilliseconds([&]() {
+					floatSpaceConvert(image, reference, stats, colorizeMode, 0.0, 1.0, stripeNum);
+					});
+
+				std::cout << std::format("{:<9} stripes {:>3}: lambda {:8.2f} ms {:8.1f} MPix/s", colorizeModeStr(colorizeMode), stripeNum, lambdaMs, megaPixels / lambdaMs * 1000);
+
+				for (auto lutSize : colorizeLutSizes) {
+
+					auto lutMs = timeMilliseconds([&]() {
+						floatSpaceConvert(image, converted, stats, colorizeMode, 0.0, 1.0, stripeNum, lutSize);
+						});
+
+					auto differ = std::inner_product(reference.begin(), reference.end(), converted.begin(), std::size_t(0), std::plus<>(), std::not_equal_to<>());
+
+					std::cout << std::format(" | lut{} {:8.2f} ms {:5.2f}x {:6.3f}% differ", lutSize, lutMs, lambdaMs / lutMs, 100.0 * differ / image.size());
+				}
+				std::cout << "\n";
+			}
+	}
+
+	//read throughput of the original buffered loop against the bulk reader, for every image HDU of a file
+	void benchmarkRead(const std::string& fileName, std::size_t chunkPixels = 0) {
+
+		fitsfile* fptr = nullptr;
+		int status = 0, hdutype = IMAGE_HDU, bitpix = 0, naxis = 0;
+		LONGLONG naxes[10] = {};
+
+		fits_open_file(&fptr, fileName.c_str(), READONLY, &status);
+		FitsHandle fits(fptr);
+		if (status)
+			throw std::runtime_error("failed to open fits");
+
+		std::cout << std::format("read benchmark, {}\n", fileName);
+
+		std::vector<float> image;
+		for (std::size_t idx = 0; status != END_OF_FILE; ++idx) {
+
+			//tables and images of fewer than two axes are skipped, header errors end the benchmark as they end a conversion
+			naxis = 0;
+			if (fits_get_hdu_type(fptr, &hdutype, &status) == 0 && hdutype == IMAGE_HDU)
+				fits_get_img_paramll(fptr, 10, &bitpix, &naxis, naxes, &status);
+
+			if (status)
+				throw std::runtime_error(std::format("failed to read the header of hdu {}", idx));
+
+			if (naxis >= 2) {
+
+				std::size_t npixels = 1;
+				for (int axis = 0; axis < naxis; ++axis)
+					npixels *= std::size_t(naxes[axis]);
+				double megaBytes = npixels * sizeof(float) / 1e6;
+
+				//the first read warms the page cache so that both readers are measured on the same footing
+				readImage(fptr, npixels, image, chunkPixels);
+
+				auto bufferedMs = timeMilliseconds([&]() { readImageBuffered(fptr, npixels, image); });
+				auto bulkMs = timeMilliseconds([&]() { readImage(fptr, npixels, image, chunkPixels); });
+
+				std::cout << std::format("hdu {} bitpix {} {}x{}: buffered {:8.1f} MB/s | bulk {:8.1f} MB/s {:5.2f}x\n",
+					idx, bitpix, naxes[0], npixels / naxes[0], megaBytes / bufferedMs * 1000, megaBytes / bulkMs * 1000, bufferedMs / bulkMs);
+			}
+
+			if (fits_movrel_hdu(fptr, 1, NULL, &status) && status != END_OF_FILE)
+				throw std::runtime_error(std::format("failed to move past hdu {}", idx));
+		}
+	}
+
+	//runs function as a task of pool and waits without taking any of the tasks it spawns,
+	//so that exactly the threads of the pool do the work
+	template<typename Function>
+	void runOnPool(ThreadPool& pool, Function&& function) {
+
+		std::promise<void> finished;
+		auto future = finished.get_future();
+
+		pool.submit([&]() {
+			try {
+				function();
+				finished.set_value();
+			}
+			catch (...) {
+				finished.set_exception(std::current_exception());
+			}
+			});
+
+		future.get();
+	}
+
+	//STREAM triad a = b + s * c split between the threads of pool, over arrays far larger than the caches, in bytes per second
+	double measureMemoryBandwidth(ThreadPool& pool, std::size_t elements = 1 << 24, std::size_t repeats = 3) {
+
+		std::vector<double> a(elements), b(elements, 1.0), c(elements, 2.0);
+
+		auto ms = timeMilliseconds([&]() {
+			runOnPool(pool, [&]() {
+
+				TaskGroup chunks(pool);
+				for (std::size_t t = 0; t < pool.size(); ++t)
+					chunks.run([&, t]() {
+						for (auto i = elements * t / pool.size(); i < elements * (t + 1) / pool.size(); ++i)
+							a[i] = b[i] + 3.0 * c[i];
+						});
+				chunks.wait();
+				});
+			}, repeats);
+
+		return 3 * sizeof(double) * elements / (ms / 1000);
+	}
+
+	struct ScalingOptions {
+
+		//thread counts run are the powers of two below maxThreads and maxThreads itself; 0 is one per hardware thread
+		std::size_t maxThreads = 0;
+
+		//strong scaling converts a side x side image at every thread count; weak scaling gives each thread
+		//side / maxThreads of its rows, ending on the same image at maxThreads
+		std::size_t side = 2048;
+
+		int bitpix = FLOAT_IMG;
+		std::size_t repeats = 3;
+
+		//the outputs and options of readFITSimagesAndColorize; threadPool is set per thread count,
+		//and prefetch and HDU threads are turned off so that the pool's threads are the only ones working
+		std::vector<OutputSpec> outputs = defaultOutputs();
+		ConvertOptions options;
+	};
+
+	//converts synthetic images with the full pipeline on pools of 1, 2, 4 .. maxThreads threads and writes a csv row
+	//per scaling mode and thread count. speedup and efficiency are against one thread, scaled by the work for weak scaling.
+	//pipeline bandwidth counts the float image and every output once, a lower bound of the memory traffic, and is
+	//given as a share of the triad bandwidth of all maxThreads threads
+	void benchmarkScaling(const ScalingOptions& options = {}, std::ostream& out = std::cout) {
+
+		auto maxThreads = options.maxThreads ? options.maxThreads : std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+
+		std::vector<std::size_t> threadCounts;
+		for (std::size_t threads = 1; threads < maxThreads; threads *= 2)
+			threadCounts.push_back(threads);
+		threadCounts.push_back(maxThreads);
+
+		//every thread count gets its own pool, whose triad bandwidth is measured once
+		std::vector<double> bandwidths;
+		for (auto threads : threadCounts) {
+			ThreadPool pool(threads);
+			bandwidths.push_back(measureMemoryBandwidth(pool));
+		}
+		double peakBandwidth = std::ranges::max(bandwidths);
+
+		//the inputs are written fresh into a directory of this run, so no file left by another run or size is measured,
+		//and the directory goes with everything in it however the run ends
+		struct ScratchDirectory {
+
+			std::filesystem::path path;
+
+			ScratchDirectory() {
+
+				std::random_device random;
+				do path = std::filesystem::temp_directory_path() / std::format("fitsconverter_scaling_{:08x}", random());
+				while (!std::filesystem::create_directory(path));
+			}
+
+			ScratchDirectory(const ScratchDirectory&) = delete;
+			ScratchDirectory& operator=(const ScratchDirectory&) = delete;
+
+			~ScratchDirectory() {
+
+				std::error_code error;
+				std::filesystem::remove_all(path, error);
+			}
+		} directory;
+
+		out << "scaling,threads,width,height,seconds,speedup,efficiency,mpixels_per_s,pipeline_gb_per_s,triad_gb_per_s,bandwidth_utilization\n";
+
+		for (auto weak : { false, true }) {
+
+			double oneThreadSeconds = 0.0;
+
+			for (std::size_t t = 0; t < threadCounts.size(); ++t) {
+
+				auto threads = threadCounts[t];
+
+				SyntheticFitsSpec spec;
+				spec.width = options.side;
+				spec.height = weak ? std::max<std::size_t>(options.side * threads / maxThreads, 1) : options.side;
+				spec.bitpix = options.bitpix;
+
+				//strong scaling converts the same file at every thread count
+				auto fileName = (directory.path / std::format("scaling_{}x{}_{}.fits", spec.width, spec.height, spec.bitpix)).string();
+				if (weak || t == 0)
+					writeSyntheticFits(fileName, spec);
+
+				ThreadPool pool(threads);
+
+				ConversionJob job{ fileName, options.outputs, {}, options.options };
+				job.options.threadPool = &pool;
+
+				//the prefetch reader and the HDU threads run outside the pool, so n threads would really be more
+				job.options.prefetchDepth = 0;
+				job.options.hduThreads = 1;
+
+				//the best run has the file and its outputs in the page cache, as a batch of many would
+				auto seconds = timeMilliseconds([&]() { runOnPool(pool, [&]() { runConversionJob(job); }); }, options.repeats) / 1000;
+
+				for (auto& outputName : outputFileNames(fileName, 0, options.outputs))
+					std::filesystem::remove(outputName);
+				if (weak || t + 1 == threadCounts.size())
+					std::filesystem::remove(fileName);
+
+				if (t == 0) oneThreadSeconds = seconds;
+
+				//weak scaling does threads times the work of one thread
+				double work = weak ? double(spec.height) / std::max<std::size_t>(options.side / maxThreads, 1) : 1.0;
+				double speedup = oneThreadSeconds / seconds * work;
+
+				std::size_t pixels = spec.width * spec.height;
+				double bytes = double(pixels * sizeof(float) + outputImageBytes(options.outputs, spec.width, spec.height, options.options.packedOutputs));
+
+				out << std::format("{},{},{},{},{:.6f},{:.3f},{:.3f},{:.2f},{:.3f},{:.3f},{:.3f}\n",
+					weak ? "weak" : "strong", threads, spec.width, spec.height, seconds, speedup, speedup / threads,
+					pixels / seconds / 1e6, bytes / seconds / 1e9, bandwidths[t] / 1e9, bytes / seconds / peakBandwidth);
+			}
+		}
+	}
+};
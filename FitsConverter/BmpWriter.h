@@ -0,0 +1,245 @@
+#pragma once
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <sys/uio.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#include "Colorize.h"
+#include "IoGate.h"
+
+#include <fstream>
+#include <string>
+#include <span>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace FitsConverter {
+
+	//the colorizers emit pixels in the layout bmp readers expect, so buffers are written as they are
+	constexpr ChannelOrder bmpChannelOrder = ChannelOrder::BGRA;
+
+	//bmp rows are padded to four bytes
+	constexpr std::size_t bmpRowStride(PixelFormat format, std::size_t width) {
+
+		return (pixelFormatRowBytes(format, width) + 3) / 4 * 4;
+	}
+
+	//BITMAPFILEHEADER and the info header. a 32 bit image in bmpChannelOrder gets a BITMAPV4HEADER with BI_BITFIELDS masks
+	//that include alpha; grey and bit images get a BITMAPINFOHEADER and a grey ramp or black and white palette.
+	//rows run bottom up, which is the order fits stores them in
+	std::vector<std::uint8_t> makeBmpHeader(std::size_t width, std::size_t height, PixelFormat format = PixelFormat::COLOR32) {
+
+		bool color = format == PixelFormat::COLOR32;
+		std::size_t infoSize = color ? 108 : 40, paletteSize = format == PixelFormat::GREY8 ? 256 : format == PixelFormat::BIT1 ? 2 : 0;
+		std::size_t headerSize = 14 + infoSize + paletteSize * 4;
+
+		std::vector<std::uint8_t> header(headerSize);
+
+		auto put = [&](std::size_t offset, std::uint32_t value, std::size_t bytes) {
+			for (std::size_t b = 0; b < bytes; ++b)
+				header[offset + b] = std::uint8_t(value >> (8 * b));
+			};
+
+		//sizes past 4GB do not fit the format; readers go by the dimensions, so they are written as 0
+		std::uint64_t imageSize = std::uint64_t(bmpRowStride(format, width)) * height;
+		auto size32 = [](std::uint64_t size) { return size > std::numeric_limits<std::uint32_t>::max() ? 0 : std::uint32_t(size); };
+
+		//BITMAPFILEHEADER
+		header[0] = 'B'; header[1] = 'M';
+		put(2, size32(headerSize + imageSize), 4);
+		put(10, std::uint32_t(headerSize), 4);
+
+		//positive height for bottom up rows
+		constexpr std::uint32_t biRgb = 0, biBitfields = 3, lcsSRGB = 0x73524742;
+
+		put(14, std::uint32_t(infoSize), 4);
+		put(18, std::uint32_t(width), 4);
+		put(22, std::uint32_t(height), 4);
+		put(26, 1, 2);
+		put(28, color ? 32 : format == PixelFormat::GREY8 ? 8 : 1, 2);
+		put(30, color ? biBitfields : biRgb, 4);
+		put(34, size32(imageSize), 4);
+		put(38, 2835, 4);
+		put(42, 2835, 4);
+		put(46, std::uint32_t(paletteSize), 4);
+
+		if (!color) {
+
+			//palette entries are b g r 0; the bit palette is black then white
+			for (std::size_t i = 0; i < paletteSize; ++i) {
+
+				std::uint32_t grey = paletteSize == 2 ? std::uint32_t(i * 255) : std::uint32_t(i);
+				put(54 + i * 4, grey * 0x010101, 4);
+			}
+			return header;
+		}
+
+		//red, green, blue and alpha masks: where each byte of an r g b a word ends up
+		put(54, toChannelOrder<bmpChannelOrder>(0x000000FF), 4);
+		put(58, toChannelOrder<bmpChannelOrder>(0x0000FF00), 4);
+		put(62, toChannelOrder<bmpChannelOrder>(0x00FF0000), 4);
+		put(66, toChannelOrder<bmpChannelOrder>(0xFF000000), 4);
+		put(70, lcsSRGB, 4);
+
+		return header;
+	}
+
+	//writes a whole bmp straight from the colorize buffer: one writev of header and pixels on posix, two writes on windows.
+	//rows of format are packed; only packed rows that are not a multiple of four bytes are copied to pad them.
+	//the writes hold a slot of writeGate
+	void writeBmpFile(const std::string& fileName, std::size_t width, std::size_t height, std::span<const std::uint8_t> rows, PixelFormat format, IoGate* writeGate = nullptr) {
+
+		auto header = makeBmpHeader(width, height, format);
+
+		auto rowBytes = pixelFormatRowBytes(format, width), stride = bmpRowStride(format, width);
+
+		std::vector<std::uint8_t> padded;
+		if (stride != rowBytes) {
+
+			padded.resize(stride * height);
+			for (std::size_t row = 0; row < height; ++row)
+				std::copy_n(rows.data() + row * rowBytes, rowBytes, padded.data() + row * stride);
+			rows = padded;
+		}
+
+		auto pixelData = rows.data();
+		std::size_t pixelBytes = rows.size_bytes();
+
+		auto slot = IoGate::enter(writeGate);
+
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(fileName.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("failed to create bmp");
+
+		auto writeAll = [&](const std::uint8_t* bytes, std::size_t size) {
+
+			while (size > 0) {
+
+				DWORD chunk = DWORD(std::min<std::size_t>(size, 1 << 30)), written = 0;
+				if (!WriteFile(file, bytes, chunk, &written, nullptr) || written == 0)
+					return false;
+
+				bytes += written;
+				size -= written;
+			}
+			return true;
+			};
+
+		bool ok = writeAll(header.data(), header.size()) && writeAll(pixelData, pixelBytes);
+		CloseHandle(file);
+#else
+		int file = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (file < 0)
+			throw std::runtime_error("failed to create bmp");
+
+		iovec parts[2] = {
+			{ header.data(), header.size() },
+			{ const_cast<std::uint8_t*>(pixelData), pixelBytes }
+		};
+
+		//writev may stop short, notably past 2GB on linux; continue from wherever it got to
+		bool ok = true;
+		for (std::size_t part = 0; ; ) {
+
+			while (part < 2 && parts[part].iov_len == 0) ++part;
+			if (part == 2) break;
+
+			auto written = ::writev(file, parts + part, int(2 - part));
+			if (written <= 0) {
+				ok = false;
+				break;
+			}
+
+			for (std::size_t done = written; done > 0; ++part) {
+
+				auto step = std::min(done, parts[part].iov_len);
+				parts[part].iov_base = static_cast<std::uint8_t*>(parts[part].iov_base) + step;
+				parts[part].iov_len -= step;
+				done -= step;
+
+				if (parts[part].iov_len != 0) break;
+			}
+		}
+		ok = ::close(file) == 0 && ok;
+#endif
+		if (!ok)
+			throw std::runtime_error("bmp write");
+	}
+
+	void writeBmpFile(const std::string& fileName, std::size_t width, std::size_t height, std::span<const std::uint32_t> pixels, IoGate* writeGate = nullptr) {
+
+		writeBmpFile(fileName, width, height, { reinterpret_cast<const std::uint8_t*>(pixels.data()), pixels.size_bytes() }, PixelFormat::COLOR32, writeGate);
+	}
+
+	//writes a bmp a band of rows at a time, for images too large to hold in memory; every write holds a slot of writeGate
+	class BmpStreamWriter {
+	public:
+
+		BmpStreamWriter(const std::string& fileName, std::size_t width, std::size_t height, PixelFormat format = PixelFormat::COLOR32, IoGate* writeGate = nullptr)
+			: rowBytes(pixelFormatRowBytes(format, width)), stride(bmpRowStride(format, width)), writeGate(writeGate) {
+
+			auto slot = IoGate::enter(writeGate);
+
+			file.open(fileName, std::ios::binary);
+			if (!file)
+				throw std::runtime_error("failed to create bmp");
+
+			auto header = makeBmpHeader(width, height, format);
+			file.write(reinterpret_cast<const char*>(header.data()), header.size());
+		}
+
+		//whole rows in the writer's pixel format
+		void appendRows(std::span<const std::uint8_t> rows) {
+
+			auto slot = IoGate::enter(writeGate);
+
+			if (stride == rowBytes)
+				file.write(reinterpret_cast<const char*>(rows.data()), rows.size());
+			else {
+
+				constexpr char padding[4] = {};
+				for (std::size_t offset = 0; offset < rows.size(); offset += rowBytes) {
+
+					file.write(reinterpret_cast<const char*>(rows.data() + offset), rowBytes);
+					file.write(padding, stride - rowBytes);
+				}
+			}
+
+			if (!file)
+				throw std::runtime_error("bmp write");
+		}
+
+		//bmpChannelOrder pixels of whole rows
+		void appendRows(std::span<const std::uint32_t> pixels) {
+
+			appendRows({ reinterpret_cast<const std::uint8_t*>(pixels.data()), pixels.size_bytes() });
+		}
+
+		void finish() {
+
+			auto slot = IoGate::enter(writeGate);
+
+			file.close();
+			if (!file)
+				throw std::runtime_error("bmp write");
+		}
+
+	private:
+
+		std::ofstream file;
+		std::size_t rowBytes, stride;
+		IoGate* writeGate;
+	};
+};
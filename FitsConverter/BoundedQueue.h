@@ -0,0 +1,70 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <optional>
+#include <algorithm>
+
+
+namespace FitsConverter {
+
+	//blocking producer/consumer queue holding at most capacity items; close wakes both sides for shutdown
+	template<typename T>
+	class BoundedQueue {
+	public:
+
+		explicit BoundedQueue(std::size_t capacity) : capacity(std::max<std::size_t>(capacity, 1)) {}
+
+		//blocks until an item could be pushed without waiting; false once the queue is closed
+		bool waitForSpace() {
+
+			std::unique_lock lock(mutex);
+			notFull.wait(lock, [&]() { return closed || items.size() < capacity; });
+			return !closed;
+		}
+
+		bool push(T item) {
+
+			std::unique_lock lock(mutex);
+			notFull.wait(lock, [&]() { return closed || items.size() < capacity; });
+
+			if (closed) return false;
+
+			items.push_back(std::move(item));
+			notEmpty.notify_one();
+			return true;
+		}
+
+		//the next item, or nothing once the queue is closed and drained
+		std::optional<T> pop() {
+
+			std::unique_lock lock(mutex);
+			notEmpty.wait(lock, [&]() { return closed || !items.empty(); });
+
+			if (items.empty()) return std::nullopt;
+
+			std::optional<T> item = std::move(items.front());
+			items.pop_front();
+			notFull.notify_one();
+			return item;
+		}
+
+		void close() {
+
+			std::scoped_lock lock(mutex);
+			closed = true;
+			notFull.notify_all();
+			notEmpty.notify_all();
+		}
+
+	private:
+
+		std::size_t capacity;
+		std::deque<T> items;
+		bool closed = false;
+
+		std::mutex mutex;
+		std::condition_variable notFull, notEmpty;
+	};
+};
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <array>
+#include <span>
+#include <new>
+#include <bit>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+
+namespace FitsConverter {
+
+	//process wide recycling of 64 byte aligned pixel buffers by size class, so the outputs of one HDU reuse the memory of the HDU before.
+	//a released buffer goes to the cache of the thread releasing it, past that to a shared list,
+	//and is freed once maxCachedBytes sit unused. the cache of an exiting thread goes to the shared list
+	class BufferPool {
+	public:
+
+		static constexpr std::size_t alignment = 64;
+
+		//owns one buffer and hands it back to the pool when destroyed
+		class Buffer {
+		public:
+
+			Buffer() = default;
+
+			Buffer(Buffer&& other) noexcept : data(std::exchange(other.data, nullptr)), sizeClass(other.sizeClass) {}
+
+			Buffer& operator=(Buffer&& other) noexcept {
+
+				if (this != &other) {
+
+					reset();
+					data = std::exchange(other.data, nullptr);
+					sizeClass = other.sizeClass;
+				}
+				return *this;
+			}
+
+			~Buffer() { reset(); }
+
+			//the first count elements; count * sizeof(T) must not exceed the requested bytes
+			template<typename T>
+			std::span<T> as(std::size_t count) const { return { static_cast<T*>(data), count }; }
+
+			void reset() {
+
+				if (data) release(std::exchange(data, nullptr), sizeClass);
+			}
+
+		private:
+
+			friend class BufferPool;
+
+			void* data = nullptr;
+			std::size_t sizeClass = 0;
+		};
+
+		//a buffer of at least bytes, uninitialized
+		static Buffer acquire(std::size_t bytes) {
+
+			Buffer buffer;
+			buffer.sizeClass = sizeClassOf(bytes);
+
+			auto& cached = threadCache().lists[buffer.sizeClass];
+			if (!cached.empty()) {
+
+				buffer.data = cached.back();
+				cached.pop_back();
+
+			} else {
+
+				std::scoped_lock lock(mutex);
+				if (!shared[buffer.sizeClass].empty()) {
+
+					buffer.data = shared[buffer.sizeClass].back();
+					shared[buffer.sizeClass].pop_back();
+				}
+			}
+
+			if (buffer.data)
+				cachedBytes -= classBytes(buffer.sizeClass);
+			else
+				buffer.data = ::operator new(classBytes(buffer.sizeClass), std::align_val_t(alignment));
+
+			return buffer;
+		}
+
+		//a buffer of count Ts and the span over them
+		template<typename T>
+		static std::pair<Buffer, std::span<T>> acquire(std::size_t count) {
+
+			auto buffer = acquire(count * sizeof(T));
+			auto elements = buffer.as<T>(count);
+			return { std::move(buffer), elements };
+		}
+
+		//frees the buffers of the shared list; thread caches stay with their threads
+		static void trim() {
+
+			std::scoped_lock lock(mutex);
+			for (std::size_t sizeClass = 0; sizeClass < classCount; ++sizeClass) {
+
+				for (auto data : shared[sizeClass]) {
+
+					cachedBytes -= classBytes(sizeClass);
+					free(data, sizeClass);
+				}
+				shared[sizeClass].clear();
+			}
+		}
+
+		static inline std::atomic<std::size_t> maxCachedBytes = std::size_t(1) << 30;
+
+		//lowers maxCachedBytes to bytes when it is above, and frees the shared list; a cap never rises again
+		static void limitCachedBytes(std::size_t bytes) {
+
+			auto current = maxCachedBytes.load();
+			while (bytes < current && !maxCachedBytes.compare_exchange_weak(current, bytes)) {}
+
+			trim();
+		}
+
+	private:
+
+		//sizes round up to a quarter power of two past 4K, wasting at most a fifth of a buffer
+		static constexpr std::size_t minClassBits = 12, stepsPerPower = 4;
+		static constexpr std::size_t classCount = (64 - minClassBits) * stepsPerPower + 1;
+
+		static std::size_t sizeClassOf(std::size_t bytes) {
+
+			if (bytes <= (std::size_t(1) << minClassBits)) return 0;
+
+			//bytes lies in (2^(bits-1), 2^bits], which splits into stepsPerPower classes
+			std::size_t bits = std::bit_width(bytes - 1), step = std::size_t(1) << (bits - 1) >> 2;
+			std::size_t steps = (bytes - (std::size_t(1) << (bits - 1)) + step - 1) / step;
+
+			return (bits - 1 - minClassBits) * stepsPerPower + steps;
+		}
+
+		static std::size_t classBytes(std::size_t sizeClass) {
+
+			if (sizeClass == 0) return std::size_t(1) << minClassBits;
+
+			std::size_t power = (sizeClass - 1) / stepsPerPower + minClassBits, steps = (sizeClass - 1) % stepsPerPower + 1;
+			return (std::size_t(1) << power) + steps * (std::size_t(1) << power >> 2);
+		}
+
+		static void free(void* data, std::size_t sizeClass) {
+
+			::operator delete(data, classBytes(sizeClass), std::align_val_t(alignment));
+		}
+
+		struct ThreadCache {
+
+			static constexpr std::size_t buffersPerClass = 16;
+
+			std::array<std::vector<void*>, classCount> lists;
+
+			~ThreadCache() {
+
+				std::scoped_lock lock(mutex);
+				for (std::size_t sizeClass = 0; sizeClass < classCount; ++sizeClass)
+					shared[sizeClass].insert(shared[sizeClass].end(), lists[sizeClass].begin(), lists[sizeClass].end());
+			}
+		};
+
+		static ThreadCache& threadCache() {
+
+			thread_local ThreadCache cache;
+			return cache;
+		}
+
+		static void release(void* data, std::size_t sizeClass) {
+
+			auto bytes = classBytes(sizeClass);
+
+			if (cachedBytes.fetch_add(bytes) + bytes > maxCachedBytes) {
+
+				cachedBytes -= bytes;
+				free(data, sizeClass);
+				return;
+			}
+
+			auto& cached = threadCache().lists[sizeClass];
+			if (cached.size() < ThreadCache::buffersPerClass) {
+
+				cached.push_back(data);
+				return;
+			}
+
+			std::scoped_lock lock(mutex);
+			shared[sizeClass].push_back(data);
+		}
+
+		static inline std::mutex mutex;
+		static inline std::array<std::vector<void*>, classCount> shared;
+		static inline std::atomic<std::size_t> cachedBytes = 0;
+	};
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "ColorizeSimd.h"
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+
+namespace FitsConverter {
+
+	//fits data is big endian; these reverse the bytes of each width byte word while copying it out
+	template<std::size_t width>
+	void byteSwapScalar(const std::byte* bigEndian, std::byte* native, std::size_t count) {
+
+		for (std::size_t i = 0; i < count; ++i)
+			for (std::size_t b = 0; b < width; ++b)
+				native[i * width + b] = bigEndian[i * width + width - 1 - b];
+	}
+
+#if defined(FITSCONVERTER_X86)
+
+	#if defined(__GNUC__)
+		#pragma GCC push_options
+		#pragma GCC target("ssse3")
+	#endif
+
+	namespace Sse42 {
+
+		template<std::size_t width>
+		std::size_t byteSwap(const std::byte* bigEndian, std::byte* native, std::size_t count) {
+
+			//pshufb mask reversing every word of the 16 byte register
+			alignas(16) std::uint8_t order[16];
+			for (std::size_t b = 0; b < 16; ++b)
+				order[b] = std::uint8_t(b - b % width + width - 1 - b % width);
+
+			auto shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(order));
+
+			std::size_t bytes = count * width / 16 * 16;
+			for (std::size_t i = 0; i < bytes; i += 16) {
+
+				auto words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bigEndian + i));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(native + i), _mm_shuffle_epi8(words, shuffle));
+			}
+			return bytes / width;
+		}
+	}
+
+	#if defined(__GNUC__)
+		#pragma GCC pop_options
+		#pragma GCC push_options
+		#pragma GCC target("avx2")
+	#endif
+
+	namespace Avx2 {
+
+		template<std::size_t width>
+		std::size_t byteSwap(const std::byte* bigEndian, std::byte* native, std::size_t count) {
+
+			//vpshufb works within each 16 byte lane, so both lanes get the same mask
+			alignas(32) std::uint8_t order[32];
+			for (std::size_t b = 0; b < 32; ++b)
+				order[b] = std::uint8_t((b % 16) - b % width + width - 1 - b % width);
+
+			auto shuffle = _mm256_load_si256(reinterpret_cast<const __m256i*>(order));
+
+			std::size_t bytes = count * width / 32 * 32;
+			for (std::size_t i = 0; i < bytes; i += 32) {
+
+				auto words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bigEndian + i));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(native + i), _mm256_shuffle_epi8(words, shuffle));
+			}
+			return bytes / width;
+		}
+	}
+
+	#if defined(__GNUC__)
+		#pragma GCC pop_options
+	#endif
+
+#endif
+
+	//copies count big endian words of width bytes into native order, vectorized on the active simd level
+	template<std::size_t width>
+	void byteSwap(const std::byte* bigEndian, std::byte* native, std::size_t count) {
+
+		std::size_t done = 0;
+
+#if defined(FITSCONVERTER_X86)
+		switch (activeSimdLevel().load(std::memory_order_relaxed)) {
+		case SimdLevel::AVX512:
+		case SimdLevel::AVX2: done = Avx2::byteSwap<width>(bigEndian, native, count); break;
+		case SimdLevel::SSE42: done = Sse42::byteSwap<width>(bigEndian, native, count); break;
+		case SimdLevel::SCALAR: break;
+		}
+#endif
+		byteSwapScalar<width>(bigEndian + done * width, native + done * width, count - done);
+	}
+
+	void byteSwapFloats(std::span<const std::byte> bigEndian, std::span<float> native) {
+
+		byteSwap<sizeof(float)>(bigEndian.data(), reinterpret_cast<std::byte*>(native.data()), native.size());
+	}
+};
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+
+
+namespace FitsConverter {
+
+	//converts fits FLOAT images to each colorize mode
+	enum class ColorizeMode {
+		NICKRGB,
+		SHORTNRGB,
+		ROYGBIV,
+		GREYSCALE,
+		BINARY
+	};
+
+
+	const char* colorizeModeStr(ColorizeMode colorizeMode) {
+		switch (colorizeMode) {
+		case ColorizeMode::NICKRGB: return "nickrgb";
+		case ColorizeMode::ROYGBIV: return "roygbiv";
+		case ColorizeMode::GREYSCALE: return "greyscale";
+		case ColorizeMode::BINARY: return "binary";
+		case ColorizeMode::SHORTNRGB: return "snrgb";
+		}
+		return "unknown";
+	}
+
+	//memory order of the bytes of a colorized pixel, chosen to match what a writer stores;
+	//RGB24 pixels are produced as RGBA words and packed to three bytes by packRgb24
+	enum class ChannelOrder {
+		RGBA,
+		BGRA,
+		ARGB,
+		RGB24
+	};
+
+	//moves the channels of an r g b a word (r in the low byte) to where order keeps them
+	template<ChannelOrder order>
+	constexpr std::uint32_t toChannelOrder(std::uint32_t rgba) {
+
+		if constexpr (order == ChannelOrder::BGRA)
+			return (rgba & 0xFF00FF00) | (rgba >> 16 & 0xFF) | (rgba & 0xFF) << 16;
+		else if constexpr (order == ChannelOrder::ARGB)
+			return rgba << 8 | rgba >> 24;
+		else
+			return rgba;
+	}
+
+	template<ChannelOrder order = ChannelOrder::RGBA>
+	constexpr std::uint32_t rgb(std::uint8_t r, std::uint8_t g, std::uint8_t b) {
+
+		//r g b a in memory order on little endian
+		return toChannelOrder<order>(std::uint32_t(r) | std::uint32_t(g) << 8 | std::uint32_t(b) << 16);
+	}
+
+	//layout of an output pixel: a 32 bit color word, a byte of grey, or one bit of black or white;
+	//rows of the packed layouts start on a byte, bits most significant first as bitmaps store them
+	enum class PixelFormat {
+		COLOR32,
+		GREY8,
+		BIT1
+	};
+
+	constexpr std::size_t pixelFormatRowBytes(PixelFormat format, std::size_t width) {
+
+		switch (format) {
+		case PixelFormat::GREY8: return width;
+		case PixelFormat::BIT1: return (width + 7) / 8;
+		default: return width * 4;
+		}
+	}
+
+	//drops the alpha byte of each RGBA pixel, for writers of 24 bit images
+	void packRgb24(std::span<const std::uint32_t> rgba, std::span<std::uint8_t> rgb) {
+
+		for (std::size_t i = 0; i < rgba.size(); ++i) {
+
+			rgb[i * 3 + 0] = std::uint8_t(rgba[i]);
+			rgb[i * 3 + 1] = std::uint8_t(rgba[i] >> 8);
+			rgb[i * 3 + 2] = std::uint8_t(rgba[i] >> 16);
+		}
+	}
+
+	auto nrgb = [](auto percent)->std::uint32_t {
+
+		//produce a three bytes (rgb) max value
+		constexpr std::uint32_t maxValue = { std::numeric_limits<std::uint32_t>::max() >> 8 };
+
+		std::uint32_t value =  maxValue * percent;
+		return value;
+		};
+
+	auto snrgb = [](auto percent)->std::uint32_t {
+
+		//produce a three bytes (rgb) max value
+		constexpr std::uint32_t maxValue = { std::numeric_limits<std::uint32_t>::max() >> 16 };
+
+		return maxValue * percent;
+		};
+	auto roygbiv = [](auto percent) {
+
+		uint8_t r = 0, g = 0, b = 0;
+
+		/*plot short rainbow RGB*/
+		float a = (1.0 - percent) / 0.20;	//invert and group
+		int X = std::floor(a);	//this is the integer part
+		float Y = std::floor(255.0 * (a - X)); //fractional part from 0 to 255
+		switch (X) {
+		case 0: r = 255; g = Y; b = 0; break;
+		case 1: r = 255 - Y; g = 255; b = 0; break;
+		case 2: r = 0; g = 255; b = Y; break;
+		case 3: r = 0; g = 255 - Y; b = 255; break;
+		case 4: r = Y; g = 0; b = 255; break;
+		case 5: r = 255; g = 0; b = 255; break;
+		}
+
+		return rgb(r, g, b);
+		};
+
+	auto grayScale = [](auto percent) {
+
+		constexpr std::uint8_t maxValue = {  std::numeric_limits<std::uint8_t>::max() };
+		std::uint8_t gray = maxValue * percent;
+		return rgb(gray, gray, gray);
+
+		};
+
+	auto binary = [](auto percent) {
+
+		constexpr std::uint8_t maxValue = { std::numeric_limits<std::uint8_t>::max() };
+		//perrcent is between 0 and 1 so round to 0 or 1 and multiply by max value for either 0 or 255
+		std::uint8_t bit = std::round(percent);
+		std::uint8_t gray = maxValue * bit;
+		return rgb(gray, gray, gray);
+
+		};
+
+	//constexpr versions of std::floor and std::round, valid for the non-negative percents used by the tables
+	constexpr double lutFloor(double x) {
+
+		auto i = static_cast<long long>(x);
+		return i > x ? i - 1 : i;
+	}
+	constexpr double lutRound(double x) {
+
+		auto f = lutFloor(x);
+		return x - f >= 0.5 ? f + 1 : f;
+	}
+
+	//compile time twin of the colorize lambdas, opaque alpha included
+	template<ColorizeMode colorMode>
+	constexpr std::uint32_t colorizeConstexpr(double percent) {
+
+		constexpr std::uint32_t opaque = 0xFF000000;
+
+		if constexpr (colorMode == ColorizeMode::NICKRGB || colorMode == ColorizeMode::SHORTNRGB) {
+
+			constexpr std::uint32_t maxValue = std::numeric_limits<std::uint32_t>::max() >> (colorMode == ColorizeMode::NICKRGB ? 8 : 16);
+			std::uint32_t value = maxValue * percent;
+			return value | opaque;
+
+		} else if constexpr (colorMode == ColorizeMode::ROYGBIV) {
+
+			std::uint8_t r = 0, g = 0, b = 0;
+
+			float a = (1.0 - percent) / 0.20;
+			int X = lutFloor(a);
+			float Y = lutFloor(255.0 * (a - X));
+			switch (X) {
+			case 0: r = 255; g = Y; b = 0; break;
+			case 1: r = 255 - Y; g = 255; b = 0; break;
+			case 2: r = 0; g = 255; b = Y; break;
+			case 3: r = 0; g = 255 - Y; b = 255; break;
+			case 4: r = Y; g = 0; b = 255; break;
+			case 5: r = 255; g = 0; b = 255; break;
+			}
+			return rgb(r, g, b) | opaque;
+
+		} else {
+
+			constexpr std::uint8_t maxValue = std::numeric_limits<std::uint8_t>::max();
+			std::uint8_t gray = colorMode == ColorizeMode::BINARY ? maxValue * std::uint8_t(lutRound(percent)) : maxValue * percent;
+			return rgb(gray, gray, gray) | opaque;
+		}
+	}
+
+	template<ColorizeMode colorMode, std::size_t size>
+	constexpr std::array<std::uint32_t, size> makeColorizeLut() {
+
+		std::array<std::uint32_t, size> lut{};
+		for (std::size_t i = 0; i < size; ++i)
+			lut[i] = colorizeConstexpr<colorMode>(double(i) / (size - 1));
+		return lut;
+	}
+
+	//entry i holds the color of percent i / (size - 1); generated at compile time
+	template<ColorizeMode colorMode, std::size_t size>
+	constexpr auto colorizeLut = makeColorizeLut<colorMode, size>();
+
+	//the supported table resolutions; 0 selects the colorize lambdas
+	constexpr std::size_t colorizeLutSizes[] = { 4096, 65536 };
+
+	template<ColorizeMode colorMode>
+	std::span<const std::uint32_t> getColorizeLut(std::size_t lutSize) {
+
+		switch (lutSize) {
+		case 4096: return colorizeLut<colorMode, 4096>;
+		case 65536: return colorizeLut<colorMode, 65536>;
+		}
+		return {};
+	}
+
+	std::span<const std::uint32_t> getColorizeLut(ColorizeMode colorMode, std::size_t lutSize) {
+
+		switch (colorMode) {
+		case ColorizeMode::NICKRGB: return getColorizeLut<ColorizeMode::NICKRGB>(lutSize);
+		case ColorizeMode::SHORTNRGB: return getColorizeLut<ColorizeMode::SHORTNRGB>(lutSize);
+		case ColorizeMode::ROYGBIV: return getColorizeLut<ColorizeMode::ROYGBIV>(lutSize);
+		case ColorizeMode::GREYSCALE: return getColorizeLut<ColorizeMode::GREYSCALE>(lutSize);
+		case ColorizeMode::BINARY: return getColorizeLut<ColorizeMode::BINARY>(lutSize);
+		}
+		return {};
+	}
+};
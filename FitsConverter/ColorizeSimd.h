@@ -0,0 +1,271 @@
+#pragma once
+
+#include "Colorize.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <array>
+
+#if defined(_M_X64) || defined(__x86_64__)
+	#define FITSCONVERTER_X86
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#endif
+#endif
+
+
+namespace FitsConverter {
+
+	enum class SimdLevel {
+		SCALAR,
+		SSE42,
+		AVX2,
+		AVX512
+	};
+
+	const char* simdLevelStr(SimdLevel level) {
+		switch (level) {
+		case SimdLevel::SCALAR: return "scalar";
+		case SimdLevel::SSE42: return "sse4.2";
+		case SimdLevel::AVX2: return "avx2";
+		case SimdLevel::AVX512: return "avx512";
+		}
+		return "unknown";
+	}
+
+	//the widest kernel this cpu and os can run
+	SimdLevel detectSimdLevel() {
+
+#if defined(FITSCONVERTER_X86) && defined(_MSC_VER)
+
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		bool sse42 = info[2] & (1 << 20), osxsave = info[2] & (1 << 27), avx = info[2] & (1 << 28);
+
+		//the os must save the ymm and zmm registers on context switches
+		unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+		bool ymmState = (xcr0 & 0x06) == 0x06, zmmState = (xcr0 & 0xE6) == 0xE6;
+
+		bool avx2 = false, avx512 = false;
+		if (maxLeaf >= 7) {
+			__cpuidex(info, 7, 0);
+			avx2 = info[1] & (1 << 5);
+			avx512 = info[1] & (1 << 16);
+		}
+
+		if (avx512 && zmmState) return SimdLevel::AVX512;
+		if (avx2 && avx && ymmState) return SimdLevel::AVX2;
+		if (sse42) return SimdLevel::SSE42;
+
+#elif defined(FITSCONVERTER_X86)
+
+		__builtin_cpu_init();
+
+		if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+		if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+		if (__builtin_cpu_supports("sse4.2")) return SimdLevel::SSE42;
+#endif
+		return SimdLevel::SCALAR;
+	}
+
+	//selected once at startup; lowered by setSimdLevel to compare kernels
+	std::atomic<SimdLevel>& activeSimdLevel() {
+
+		static std::atomic<SimdLevel> level = detectSimdLevel();
+		return level;
+	}
+
+	void setSimdLevel(SimdLevel level) {
+
+		activeSimdLevel() = std::min(level, detectSimdLevel());
+	}
+
+#if defined(FITSCONVERTER_X86)
+
+	//(v)pshufb pattern taking the r g b a bytes of every pixel to order; indices are per 16 byte lane
+	template<ChannelOrder order>
+	constexpr std::array<std::int8_t, 32> channelShuffle = []() {
+
+		constexpr std::array<std::int8_t, 4> pixel = order == ChannelOrder::BGRA ? std::array<std::int8_t, 4>{ 2, 1, 0, 3 }
+			: order == ChannelOrder::ARGB ? std::array<std::int8_t, 4>{ 3, 0, 1, 2 } : std::array<std::int8_t, 4>{ 0, 1, 2, 3 };
+
+		std::array<std::int8_t, 32> shuffle{};
+		for (std::size_t i = 0; i < shuffle.size(); ++i)
+			shuffle[i] = std::int8_t(i % 16 - i % 4 + pixel[i % 4]);
+		return shuffle;
+		}();
+
+	//bit order flip of a byte: movemask puts the first pixel lowest, bitmaps want it highest
+	constexpr std::array<std::uint8_t, 256> bitReverse = []() {
+
+		std::array<std::uint8_t, 256> reversed{};
+		for (std::size_t i = 0; i < reversed.size(); ++i)
+			for (std::size_t b = 0; b < 8; ++b)
+				if (i & (1u << b)) reversed[i] |= std::uint8_t(0x80 >> b);
+		return reversed;
+		}();
+
+	template<ChannelOrder order>
+	constexpr bool channelShuffled = order == ChannelOrder::BGRA || order == ChannelOrder::ARGB;
+
+	//each instruction set is compiled for its own target; msvc needs no flags for intrinsics
+	#if defined(__GNUC__)
+		#pragma GCC push_options
+		#pragma GCC target("sse4.2")
+	#endif
+
+	namespace Sse42 {
+
+		struct Simd {
+
+			using Vector = __m128d;
+			using Mask = __m128d;
+			static constexpr std::size_t lanes = 2;
+
+			static Vector load(const float* p) { return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)))); }
+			static Vector set(double d) { return _mm_set1_pd(d); }
+			static Vector add(Vector a, Vector b) { return _mm_add_pd(a, b); }
+			static Vector sub(Vector a, Vector b) { return _mm_sub_pd(a, b); }
+			static Vector mul(Vector a, Vector b) { return _mm_mul_pd(a, b); }
+			static Vector div(Vector a, Vector b) { return _mm_div_pd(a, b); }
+			static Vector floor(Vector a) { return _mm_floor_pd(a); }
+			static Vector trunc(Vector a) { return _mm_round_pd(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+			static Vector roundToFloat(Vector a) { return _mm_cvtps_pd(_mm_cvtpd_ps(a)); }
+			static Mask less(Vector a, Vector b) { return _mm_cmplt_pd(a, b); }
+			static Mask greaterEqual(Vector a, Vector b) { return _mm_cmpge_pd(a, b); }
+			static Mask equal(Vector a, Vector b) { return _mm_cmpeq_pd(a, b); }
+			static Vector select(Mask m, Vector a, Vector b) { return _mm_blendv_pd(b, a, m); }
+			static unsigned movemask(Mask m) { return unsigned(_mm_movemask_pd(m)); }
+			template<ChannelOrder order>
+			static void storeOpaque(std::uint32_t* p, Vector rgb) {
+				auto rgba = _mm_or_si128(_mm_cvttpd_epi32(rgb), _mm_set1_epi32(0xFF000000));
+				if constexpr (channelShuffled<order>)
+					rgba = _mm_shuffle_epi8(rgba, _mm_loadu_si128(reinterpret_cast<const __m128i*>(channelShuffle<order>.data())));
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(p), rgba);
+			}
+		};
+
+		#include "ColorizeSimdKernel.inl"
+	}
+
+	#if defined(__GNUC__)
+		#pragma GCC pop_options
+		#pragma GCC push_options
+		#pragma GCC target("avx2")
+	#endif
+
+	namespace Avx2 {
+
+		struct Simd {
+
+			using Vector = __m256d;
+			using Mask = __m256d;
+			static constexpr std::size_t lanes = 4;
+
+			static Vector load(const float* p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+			static Vector set(double d) { return _mm256_set1_pd(d); }
+			static Vector add(Vector a, Vector b) { return _mm256_add_pd(a, b); }
+			static Vector sub(Vector a, Vector b) { return _mm256_sub_pd(a, b); }
+			static Vector mul(Vector a, Vector b) { return _mm256_mul_pd(a, b); }
+			static Vector div(Vector a, Vector b) { return _mm256_div_pd(a, b); }
+			static Vector floor(Vector a) { return _mm256_floor_pd(a); }
+			static Vector trunc(Vector a) { return _mm256_round_pd(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+			static Vector roundToFloat(Vector a) { return _mm256_cvtps_pd(_mm256_cvtpd_ps(a)); }
+			static Mask less(Vector a, Vector b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+			static Mask greaterEqual(Vector a, Vector b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+			static Mask equal(Vector a, Vector b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+			static Vector select(Mask m, Vector a, Vector b) { return _mm256_blendv_pd(b, a, m); }
+			static unsigned movemask(Mask m) { return unsigned(_mm256_movemask_pd(m)); }
+			template<ChannelOrder order>
+			static void storeOpaque(std::uint32_t* p, Vector rgb) {
+				auto rgba = _mm_or_si128(_mm256_cvttpd_epi32(rgb), _mm_set1_epi32(0xFF000000));
+				if constexpr (channelShuffled<order>)
+					rgba = _mm_shuffle_epi8(rgba, _mm_loadu_si128(reinterpret_cast<const __m128i*>(channelShuffle<order>.data())));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(p), rgba);
+			}
+		};
+
+		#include "ColorizeSimdKernel.inl"
+	}
+
+	#if defined(__GNUC__)
+		#pragma GCC pop_options
+		#pragma GCC push_options
+		#pragma GCC target("avx512f")
+	#endif
+
+	namespace Avx512 {
+
+		struct Simd {
+
+			using Vector = __m512d;
+			using Mask = __mmask8;
+			static constexpr std::size_t lanes = 8;
+
+			static Vector load(const float* p) { return _mm512_cvtps_pd(_mm256_loadu_ps(p)); }
+			static Vector set(double d) { return _mm512_set1_pd(d); }
+			static Vector add(Vector a, Vector b) { return _mm512_add_pd(a, b); }
+			static Vector sub(Vector a, Vector b) { return _mm512_sub_pd(a, b); }
+			static Vector mul(Vector a, Vector b) { return _mm512_mul_pd(a, b); }
+			static Vector div(Vector a, Vector b) { return _mm512_div_pd(a, b); }
+			static Vector floor(Vector a) { return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+			static Vector trunc(Vector a) { return _mm512_roundscale_pd(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+			static Vector roundToFloat(Vector a) { return _mm512_cvtps_pd(_mm512_cvtpd_ps(a)); }
+			static Mask less(Vector a, Vector b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+			static Mask greaterEqual(Vector a, Vector b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+			static Mask equal(Vector a, Vector b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+			static Vector select(Mask m, Vector a, Vector b) { return _mm512_mask_blend_pd(m, b, a); }
+			static unsigned movemask(Mask m) { return unsigned(m); }
+			template<ChannelOrder order>
+			static void storeOpaque(std::uint32_t* p, Vector rgb) {
+				auto rgba = _mm256_or_si256(_mm512_cvttpd_epi32(rgb), _mm256_set1_epi32(0xFF000000));
+				if constexpr (channelShuffled<order>)
+					rgba = _mm256_shuffle_epi8(rgba, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(channelShuffle<order>.data())));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(p), rgba);
+			}
+		};
+
+		#include "ColorizeSimdKernel.inl"
+	}
+
+	#if defined(__GNUC__)
+		#pragma GCC pop_options
+	#endif
+
+#endif
+
+	//converts the leading whole vectors of data with the active kernel and returns how many pixels it did;
+	//the tail, and everything on a scalar level, is left to the caller
+	template<ChannelOrder order = ChannelOrder::RGBA>
+	std::size_t colorizeSpanSimd(std::span<const float> data, std::span<std::uint32_t> converted, ColorizeMode colorMode, double viewMin, double viewDistance, double stripeDistance) {
+
+#if defined(FITSCONVERTER_X86)
+		switch (activeSimdLevel().load(std::memory_order_relaxed)) {
+		case SimdLevel::AVX512: return Avx512::colorizeSpan<order>(data.data(), converted.data(), data.size(), colorMode, viewMin, viewDistance, stripeDistance);
+		case SimdLevel::AVX2: return Avx2::colorizeSpan<order>(data.data(), converted.data(), data.size(), colorMode, viewMin, viewDistance, stripeDistance);
+		case SimdLevel::SSE42: return Sse42::colorizeSpan<order>(data.data(), converted.data(), data.size(), colorMode, viewMin, viewDistance, stripeDistance);
+		case SimdLevel::SCALAR: break;
+		}
+#endif
+		return 0;
+	}
+
+	//packs the leading whole bytes of BINARY pixels with the active kernel and returns how many pixels it did
+	std::size_t packBinarySimd(std::span<const float> data, std::uint8_t* bits, double viewMin, double viewDistance, double stripeDistance) {
+
+#if defined(FITSCONVERTER_X86)
+		switch (activeSimdLevel().load(std::memory_order_relaxed)) {
+		case SimdLevel::AVX512: return Avx512::packBinaryKernel(data.data(), bits, data.size(), viewMin, viewDistance, stripeDistance);
+		case SimdLevel::AVX2: return Avx2::packBinaryKernel(data.data(), bits, data.size(), viewMin, viewDistance, stripeDistance);
+		case SimdLevel::SSE42: return Sse42::packBinaryKernel(data.data(), bits, data.size(), viewMin, viewDistance, stripeDistance);
+		case SimdLevel::SCALAR: break;
+		}
+#endif
+		return 0;
+	}
+};
@@ -0,0 +1,107 @@
+//generic body of the simd colorize kernels, included once per instruction set by ColorizeSimd.h
+//inside a namespace that defines the Simd wrapper for that instruction set.
+//every step mirrors convertToGreyScale and the colorize lambdas operation for operation,
+//so the results are bit identical to the scalar path
+
+//lambdas would not inherit the gcc target of the including region, so helpers are plain functions
+Simd::Mask isGroup(Simd::Vector X, double group) {
+
+	return Simd::equal(X, Simd::set(group));
+}
+
+template<ColorizeMode colorMode>
+Simd::Vector colorizeValue(Simd::Vector percent) {
+
+	//the rgb bytes of the pixel as a double in 0 .. 0xFFFFFF, alpha is added on store
+	if constexpr (colorMode == ColorizeMode::NICKRGB) {
+
+		return Simd::trunc(Simd::mul(Simd::set(std::numeric_limits<std::uint32_t>::max() >> 8), percent));
+
+	} else if constexpr (colorMode == ColorizeMode::SHORTNRGB) {
+
+		return Simd::trunc(Simd::mul(Simd::set(std::numeric_limits<std::uint32_t>::max() >> 16), percent));
+
+	} else if constexpr (colorMode == ColorizeMode::GREYSCALE) {
+
+		auto gray = Simd::trunc(Simd::mul(Simd::set(255.0), percent));
+		return Simd::mul(gray, Simd::set(0x010101));
+
+	} else if constexpr (colorMode == ColorizeMode::BINARY) {
+
+		//std::round of a percent is 1 exactly when it is at least one half
+		return Simd::select(Simd::greaterEqual(percent, Simd::set(0.5)), Simd::set(0xFFFFFF), Simd::set(0.0));
+
+	} else {
+
+		//roygbiv: a is stored as float in the lambda, X and Y are its integer and scaled fractional parts
+		auto a = Simd::roundToFloat(Simd::div(Simd::sub(Simd::set(1.0), percent), Simd::set(0.20)));
+		auto X = Simd::floor(a);
+		auto Y = Simd::floor(Simd::mul(Simd::set(255.0), Simd::sub(a, X)));
+
+		auto full = Simd::set(255.0), zero = Simd::set(0.0), inverse = Simd::sub(full, Y);
+		auto r = Simd::select(isGroup(X, 0), full, Simd::select(isGroup(X, 1), inverse, Simd::select(isGroup(X, 4), Y, Simd::select(isGroup(X, 5), full, zero))));
+		auto g = Simd::select(isGroup(X, 0), Y, Simd::select(isGroup(X, 1), full, Simd::select(isGroup(X, 2), full, Simd::select(isGroup(X, 3), inverse, zero))));
+		auto b = Simd::select(isGroup(X, 2), Y, Simd::select(isGroup(X, 3), full, Simd::select(isGroup(X, 4), full, Simd::select(isGroup(X, 5), full, zero))));
+
+		return Simd::add(r, Simd::add(Simd::mul(g, Simd::set(0x100)), Simd::mul(b, Simd::set(0x10000))));
+	}
+}
+
+Simd::Vector stripePercent(const float* data, Simd::Vector min, Simd::Vector distance, Simd::Vector stripe) {
+
+	auto f = Simd::sub(Simd::load(data), min);
+
+	//NaN and values past the view compare false and become percent 1, as in convertToGreyScale
+	auto inView = Simd::less(f, distance);
+
+	f = Simd::sub(f, Simd::mul(stripe, Simd::floor(Simd::div(f, stripe))));
+	auto percent = Simd::select(inView, Simd::div(f, stripe), Simd::set(1.0));
+
+	//NaN percents become 1 and the rest are clamped to 0 .. 1, in the order std::clamp compares them
+	auto zero = Simd::set(0.0), one = Simd::set(1.0);
+	percent = Simd::select(Simd::equal(percent, percent), percent, one);
+	percent = Simd::select(Simd::less(percent, zero), zero, percent);
+	return Simd::select(Simd::less(one, percent), one, percent);
+}
+
+template<ColorizeMode colorMode, ChannelOrder order>
+std::size_t colorizeKernel(const float* data, std::uint32_t* converted, std::size_t count, double viewMin, double viewDistance, double stripeDistance) {
+
+	auto min = Simd::set(viewMin), distance = Simd::set(viewDistance), stripe = Simd::set(stripeDistance);
+
+	std::size_t i = 0;
+	for (; i + Simd::lanes <= count; i += Simd::lanes)
+		Simd::storeOpaque<order>(converted + i, colorizeValue<colorMode>(stripePercent(data + i, min, distance, stripe)));
+
+	return i;
+}
+
+//BINARY one bit per pixel, taken straight from the comparison mask; converts whole bytes of eight pixels
+std::size_t packBinaryKernel(const float* data, std::uint8_t* bits, std::size_t count, double viewMin, double viewDistance, double stripeDistance) {
+
+	auto min = Simd::set(viewMin), distance = Simd::set(viewDistance), stripe = Simd::set(stripeDistance), half = Simd::set(0.5);
+
+	std::size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+
+		unsigned lowFirst = 0;
+		for (std::size_t lane = 0; lane < 8; lane += Simd::lanes)
+			lowFirst |= Simd::movemask(Simd::greaterEqual(stripePercent(data + i + lane, min, distance, stripe), half)) << lane;
+
+		bits[i / 8] = bitReverse[lowFirst];
+	}
+	return i;
+}
+
+template<ChannelOrder order>
+std::size_t colorizeSpan(const float* data, std::uint32_t* converted, std::size_t count, ColorizeMode colorMode, double viewMin, double viewDistance, double stripeDistance) {
+
+	switch (colorMode) {
+	case ColorizeMode::NICKRGB: return colorizeKernel<ColorizeMode::NICKRGB, order>(data, converted, count, viewMin, viewDistance, stripeDistance);
+	case ColorizeMode::SHORTNRGB: return colorizeKernel<ColorizeMode::SHORTNRGB, order>(data, converted, count, viewMin, viewDistance, stripeDistance);
+	case ColorizeMode::ROYGBIV: return colorizeKernel<ColorizeMode::ROYGBIV, order>(data, converted, count, viewMin, viewDistance, stripeDistance);
+	case ColorizeMode::GREYSCALE: return colorizeKernel<ColorizeMode::GREYSCALE, order>(data, converted, count, viewMin, viewDistance, stripeDistance);
+	case ColorizeMode::BINARY: return colorizeKernel<ColorizeMode::BINARY, order>(data, converted, count, viewMin, viewDistance, stripeDistance);
+	}
+	return 0;
+}
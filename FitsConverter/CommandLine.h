@@ -0,0 +1,264 @@
+#pragma once
+
+#include "FitsConverter.h"
+#include "BatchConverter.h"
+
+#include <string>
+#include <string_view>
+#include <span>
+#include <vector>
+#include <charconv>
+#include <stdexcept>
+
+
+namespace FitsConverter {
+
+	constexpr const char* commandLineUsage = R"(usage: FitsConverter <file.fits> [options]
+       FitsConverter --batch <directory, file.fits or @list>... [options]
+
+outputs, every combination of the lists given (the others keep their defaults):
+  --modes <mode,...>          greyscale, roygbiv, nickrgb, binary, snrgb (default all)
+  --stripes <n,...>           stripe counts (default 1,2,10,20,50,100)
+  --views <min:max,...>       view windows as fractions of the data range (default 0:1)
+  --formats <format,...>      bmp, png (default bmp)
+and single outputs, repeatable:
+  --output <mode:stripes[:min:max][:format]>
+with neither, every mode at every default stripe count is written as bmp
+
+  --hdus <n,...>              HDUs to convert, numbered from 0 as in the file names (default every image HDU)
+
+  --quantize                  render through a 16 bit index plane
+  --lut <size>                colorize through tables of 4096 or 65536 entries
+  --band-rows <n>             image rows per band task
+  --read-chunk <pixels>       pixels per fits read
+  --mmap                      read uncompressed HDUs from a memory mapping
+  --no-native-integer         read 8 and 16 bit HDUs as floats
+  --prefetch <n>              HDUs decoded ahead of the one being colorized
+  --hdu-threads <n>           HDUs converted at once, 0 for one per hardware thread
+  --memory-budget <bytes>     stream HDUs larger than this in row bands
+  --freeimage                 save bmps through FreeImage
+  --no-packed                 write greyscale and binary as 32 bit images
+  --png-level <0-9>           zlib level of png output
+  --profile-report <file>     json stage report of a build with FITSCONVERTER_PROFILE (default fitsconverter_profile.json)
+
+batches:
+  --recursive                 take the fits files of subdirectories too
+  --files <n>                 files converted at once (default 4)
+  --readers <n>               fits reads at once (default 2)
+  --writers <n>               output writes at once (default 4)
+  --cpu-threads <n>           colorizing workers, 0 for one per hardware thread
+
+diagnostics, each given alone as the first argument:
+  --verify [tolerance [outlier fraction]]
+                              check every colorize engine against the reference colors; with a tolerance
+                              the lut and quantize approximations too. exits 1 on any mismatch
+  --bench-lut                 time the colorize tables against the colorize lambdas
+  --bench-read <file.fits> [chunk pixels]
+                              time the buffered and bulk fits readers on every image HDU of a file
+  --bench-scaling [max threads [side]]
+                              csv of the strong and weak thread scaling of the whole conversion
+)";
+
+	std::vector<std::string_view> splitList(std::string_view list, char separator = ',') {
+
+		std::vector<std::string_view> items;
+
+		for (std::size_t start = 0; ; ) {
+
+			auto end = list.find(separator, start);
+			items.push_back(list.substr(start, end - start));
+
+			if (end == std::string_view::npos) break;
+			start = end + 1;
+		}
+		return items;
+	}
+
+	template<typename Number>
+	Number parseNumber(std::string_view text) {
+
+		Number number{};
+		auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), number);
+
+		if (error != std::errc() || end != text.data() + text.size())
+			throw std::runtime_error(std::format("not a number: '{}'", text));
+
+		return number;
+	}
+
+	ColorizeMode parseColorizeMode(std::string_view name) {
+
+		for (auto colorizeMode : { ColorizeMode::GREYSCALE, ColorizeMode::ROYGBIV, ColorizeMode::NICKRGB, ColorizeMode::BINARY, ColorizeMode::SHORTNRGB })
+			if (name == colorizeModeStr(colorizeMode)) return colorizeMode;
+
+		throw std::runtime_error(std::format("unknown colorize mode: '{}'", name));
+	}
+
+	OutputFormat parseOutputFormat(std::string_view name) {
+
+		for (auto format : { OutputFormat::BMP, OutputFormat::PNG })
+			if (name == outputFormatStr(format)) return format;
+
+		throw std::runtime_error(std::format("unknown output format: '{}'", name));
+	}
+
+	//min:max
+	std::pair<double, double> parseViewWindow(std::string_view text) {
+
+		auto bounds = splitList(text, ':');
+		if (bounds.size() != 2)
+			throw std::runtime_error(std::format("view window is not min:max: '{}'", text));
+
+		return { parseNumber<double>(bounds[0]), parseNumber<double>(bounds[1]) };
+	}
+
+	//mode:stripes[:min:max][:format]
+	OutputSpec parseOutputSpec(std::string_view text) {
+
+		auto fields = splitList(text, ':');
+		if (fields.size() < 2 || fields.size() > 5)
+			throw std::runtime_error(std::format("output is not mode:stripes[:min:max][:format]: '{}'", text));
+
+		OutputSpec output;
+		output.colorMode = parseColorizeMode(fields[0]);
+		output.stripes = parseNumber<int>(fields[1]);
+
+		if (fields.size() >= 4) {
+			output.viewMin = parseNumber<double>(fields[2]);
+			output.viewMax = parseNumber<double>(fields[3]);
+		}
+		if (fields.size() % 2 == 1)
+			output.format = parseOutputFormat(fields.back());
+
+		return output;
+	}
+
+	struct CommandLine {
+
+		//fileName is the file of a single conversion, and is left empty for a batch
+		ConversionJob job;
+
+		//directories, fits files and @lists of a batch; empty for a single conversion
+		std::vector<std::string> batchInputs;
+		BatchOptions batch;
+
+		//where the stage report is written at exit; empty keeps the profiler's default
+		std::string profileReport;
+	};
+
+	//the command line as described by commandLineUsage, args without the program name.
+	//throws std::runtime_error naming the first argument it cannot use
+	CommandLine parseCommandLine(std::span<const std::string_view> args) {
+
+		CommandLine commandLine;
+		auto& job = commandLine.job;
+		auto& batch = commandLine.batch;
+		job.outputs.clear();
+
+		std::vector<std::string> inputs;
+		bool batchMode = false;
+
+		std::vector<ColorizeMode> modes = { ColorizeMode::GREYSCALE, ColorizeMode::ROYGBIV, ColorizeMode::NICKRGB, ColorizeMode::BINARY, ColorizeMode::SHORTNRGB };
+		std::vector<int> stripes = { 1,2,10,20,50,100 };
+		std::vector<std::pair<double, double>> views = { { 0.0, 1.0 } };
+		std::vector<OutputFormat> formats = { OutputFormat::BMP };
+		bool crossOutputs = false;
+
+		auto& options = job.options;
+
+		for (std::size_t i = 0; i < args.size(); ++i) {
+
+			auto arg = args[i];
+
+			auto value = [&]() {
+				if (i + 1 == args.size())
+					throw std::runtime_error(std::format("{} needs a value", arg));
+				return args[++i];
+			};
+
+			auto parseList = [&](auto&& parseItem, auto& list) {
+				list.clear();
+				for (auto item : splitList(value()))
+					list.push_back(parseItem(item));
+				crossOutputs = true;
+			};
+
+			if (!arg.starts_with("--")) inputs.emplace_back(arg);
+			else if (arg == "--batch") batchMode = true;
+			else if (arg == "--recursive") batch.recursive = true;
+			else if (arg == "--files") batch.fileThreads = parseNumber<std::size_t>(value());
+			else if (arg == "--readers") batch.maxReads = parseNumber<std::size_t>(value());
+			else if (arg == "--writers") batch.maxWrites = parseNumber<std::size_t>(value());
+			else if (arg == "--cpu-threads") batch.cpuThreads = parseNumber<std::size_t>(value());
+			else if (arg == "--modes") parseList(parseColorizeMode, modes);
+			else if (arg == "--stripes") parseList(parseNumber<int>, stripes);
+			else if (arg == "--views") parseList(parseViewWindow, views);
+			else if (arg == "--formats") parseList(parseOutputFormat, formats);
+			else if (arg == "--output") job.outputs.push_back(parseOutputSpec(value()));
+			else if (arg == "--hdus") {
+				for (auto item : splitList(value()))
+					job.hdus.push_back(parseNumber<std::size_t>(item));
+			}
+			else if (arg == "--quantize") options.quantize = true;
+			else if (arg == "--lut") options.colorizeLutSize = parseNumber<std::size_t>(value());
+			else if (arg == "--band-rows") options.bandRows = parseNumber<std::size_t>(value());
+			else if (arg == "--read-chunk") options.readChunkPixels = parseNumber<std::size_t>(value());
+			else if (arg == "--mmap") options.memoryMap = true;
+			else if (arg == "--no-native-integer") options.nativeInteger = false;
+			else if (arg == "--prefetch") options.prefetchDepth = parseNumber<std::size_t>(value());
+			else if (arg == "--hdu-threads") options.hduThreads = parseNumber<std::size_t>(value());
+			else if (arg == "--memory-budget") options.memoryBudget = parseNumber<std::size_t>(value());
+			else if (arg == "--freeimage") options.freeImageBmp = true;
+			else if (arg == "--no-packed") options.packedOutputs = false;
+			else if (arg == "--png-level") options.pngLevel = parseNumber<int>(value());
+			else if (arg == "--profile-report") {
+				if (!profilingEnabled)
+					throw std::runtime_error("--profile-report needs a build with FITSCONVERTER_PROFILE defined");
+				commandLine.profileReport = value();
+			}
+			else
+				throw std::runtime_error(std::format("unknown option: '{}'", arg));
+		}
+
+		if (batchMode) {
+
+			if (inputs.empty())
+				throw std::runtime_error("no batch inputs given");
+			commandLine.batchInputs = std::move(inputs);
+
+		} else {
+
+			if (inputs.size() != 1)
+				throw std::runtime_error(inputs.empty() ? "no fits file given" : "more than one fits file given, use --batch");
+			job.fileName = inputs[0];
+		}
+
+		if (crossOutputs || job.outputs.empty())
+			for (auto stripeNum : stripes)
+				for (auto [viewMin, viewMax] : views)
+					for (auto format : formats)
+						for (auto colorizeMode : modes)
+							job.outputs.push_back({ colorizeMode, stripeNum, viewMin, viewMax, format });
+
+		//planColorizePasses rejects these too, but without saying which argument they came from
+		for (auto& output : job.outputs)
+			if (output.stripes < 1 || !(output.viewMin >= 0.0 && output.viewMin < output.viewMax && output.viewMax <= 1.0))
+				throw std::runtime_error(std::format("output {}:{}:{}:{} needs stripes of at least 1 and 0 <= min < max <= 1",
+					colorizeModeStr(output.colorMode), output.stripes, output.viewMin, output.viewMax));
+
+		if (options.colorizeLutSize != 0 && options.colorizeLutSize != 4096 && options.colorizeLutSize != 65536)
+			throw std::runtime_error("--lut takes 4096 or 65536");
+
+		//-1 is zlib's default level
+		if (options.pngLevel != Z_DEFAULT_COMPRESSION && (options.pngLevel < 0 || options.pngLevel > 9))
+			throw std::runtime_error("--png-level takes 0 to 9");
+
+		return commandLine;
+	}
+
+	CommandLine parseCommandLine(int argc, char* argv[]) {
+
+		std::vector<std::string_view> args(argv + 1, argv + argc);
+		return parseCommandLine(args);
+	}
+};
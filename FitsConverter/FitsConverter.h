@@ -1,5 +1,7 @@
 #pragma once
 
+#include "MappedFile.h"
+
 #define FREEIMAGE_LIB
 #include <FreeImage.h>
 #include <fitsio.h>
@@ -7,124 +9,223 @@
 #include <string>
 #include <span>
 #include <vector>
+#include <array>
 #include <execution>
 #include <algorithm>
 #include <format>
+#include <cmath>
+#include <limits>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+#include <mutex>
+#include <atomic>
+#include <filesystem>
+
+#include "Colorize.h"
+#include "ColorizeSimd.h"
+#include "ThreadPool.h"
+#include "ByteSwap.h"
+#include "BoundedQueue.h"
+#include "BmpWriter.h"
+#include "PngWriter.h"
+#include "BufferPool.h"
+#include "FreeImagePool.h"
+#include "Profiler.h"
 
 
 namespace FitsConverter {
 
-	//converts fits FLOAT images to each colorize mode
-	enum class ColorizeMode {
-		NICKRGB,
-		SHORTNRGB,
-		ROYGBIV,
-		GREYSCALE,
-		BINARY
+	//statistics of one image, computed once per HDU and shared by every colorize pass
+	struct ImageStats {
+
+		double min = 0.0, max = 0.0, mean = 0.0;
+		std::size_t count = 0, nanCount = 0;
 	};
 
+	//running min/max/mean over the pieces of an image, for readers that never hold all of it at once
+	struct StatsAccumulator {
+
+		float min = std::numeric_limits<float>::max(), max = std::numeric_limits<float>::lowest();
+		double sum = 0.0;
+		std::size_t count = 0, nanCount = 0;
+
+		//NaN pixels are counted but do not take part in min/max/mean
+		void add(std::span<const float> data) {
+
+			for (auto f : data) {
+
+				if (std::isnan(f)) {
+					++nanCount;
+					continue;
+				}
+
+				if (f < min) min = f;
+				if (f > max) max = f;
+				sum += f;
+			}
+			count += data.size();
+		}
+
+		ImageStats stats() const {
+
+			ImageStats stats;
+			stats.count = count;
+			stats.nanCount = nanCount;
 
-	std::uint32_t rgb(std::uint8_t r, std::uint8_t g, std::uint8_t b) {
+			std::size_t valid = count - nanCount;
+			if (valid > 0) {
+				stats.min = min;
+				stats.max = max;
+				stats.mean = sum / valid;
+			}
+			return stats;
+		}
+	};
 
-		std::uint32_t rgba = 0;
-		std::uint8_t* bytes = reinterpret_cast<std::uint8_t*>(&rgba);
-		bytes[0] = r;
-		bytes[1] = g;
-		bytes[2] = b;
+	ImageStats computeImageStats(std::span<const float> data) {
 
-		return rgba;
+		//single pass over the image
+		StatsAccumulator accumulator;
+		accumulator.add(data);
+		return accumulator.stats();
 	}
 
-	auto nrgb = [&](auto percent)->std::uint32_t {
+	//pixels of an uncompressed HDU exactly as stored on disk: big endian BITPIX typed values
+	//that become physical floats, bzero + bscale * raw, one tile at a time
+	struct RawImage {
 
-		//produce a three bytes (rgb) max value
-		constexpr std::uint32_t maxValue = { std::numeric_limits<std::uint32_t>::max() >> 8 };
+		std::span<const std::byte> bytes;
+		int bitpix = FLOAT_IMG;
+		double bscale = 1.0, bzero = 0.0;
 
-		std::uint32_t value =  maxValue * percent;
-		return value;
-		};
+		std::size_t pixelSize() const { return std::abs(bitpix) / 8; }
+		std::size_t size() const { return bytes.size() / pixelSize(); }
 
-	auto snrgb = [&](auto percent)->std::uint32_t {
+		RawImage subspan(std::size_t offset, std::size_t count) const {
+			return { bytes.subspan(offset * pixelSize(), count * pixelSize()), bitpix, bscale, bzero };
+		}
+	};
 
-		//produce a three bytes (rgb) max value
-		constexpr std::uint32_t maxValue = { std::numeric_limits<std::uint32_t>::max() >> 16 };
+	template<typename Raw>
+	void decodeScaled(std::span<const std::byte> bigEndian, std::span<float> pixels, double bscale, double bzero) {
 
-		return maxValue * percent;
-		};
-	auto roygbiv = [&](auto percent) {
-
-		uint8_t r = 0, g = 0, b = 0;
-
-		/*plot short rainbow RGB*/
-		float a = (1.0 - percent) / 0.20;	//invert and group
-		int X = std::floor(a);	//this is the integer part
-		float Y = std::floor(255.0 * (a - X)); //fractional part from 0 to 255
-		switch (X) {
-		case 0: r = 255; g = Y; b = 0; break;
-		case 1: r = 255 - Y; g = 255; b = 0; break;
-		case 2: r = 0; g = 255; b = Y; break;
-		case 3: r = 0; g = 255 - Y; b = 255; break;
-		case 4: r = Y; g = 0; b = 255; break;
-		case 5: r = 255; g = 0; b = 255; break;
+		thread_local std::vector<Raw> raw;
+		raw.resize(pixels.size());
+
+		byteSwap<sizeof(Raw)>(bigEndian.data(), reinterpret_cast<std::byte*>(raw.data()), raw.size());
+
+		//the same double precision scaling cfitsio applies when reading as TFLOAT
+		for (std::size_t i = 0; i < pixels.size(); ++i)
+			pixels[i] = raw[i] * bscale + bzero;
+	}
+
+	//byte swap, widen and scale one piece of a raw image into native physical floats
+	void decodeRawPixels(const RawImage& image, std::span<float> pixels) {
+
+		bool unscaled = image.bscale == 1.0 && image.bzero == 0.0;
+
+		switch (image.bitpix) {
+		case FLOAT_IMG:
+			if (unscaled)
+				byteSwapFloats(image.bytes, pixels);
+			else
+				decodeScaled<float>(image.bytes, pixels, image.bscale, image.bzero);
+			break;
+		case DOUBLE_IMG: decodeScaled<double>(image.bytes, pixels, image.bscale, image.bzero); break;
+		case LONG_IMG: decodeScaled<std::int32_t>(image.bytes, pixels, image.bscale, image.bzero); break;
+		case SHORT_IMG: decodeScaled<std::int16_t>(image.bytes, pixels, image.bscale, image.bzero); break;
+		case BYTE_IMG: decodeScaled<std::uint8_t>(image.bytes, pixels, image.bscale, image.bzero); break;
+		default:
+			throw std::runtime_error("unsupported bitpix");
 		}
+	}
 
-		return rgb(r, g, b);
-		};
+	//16KB of floats, small enough to stay in L1 while every variant is written from it
+	constexpr std::size_t defaultTileSize = 4096;
 
-	auto grayScale = [&](auto percent) {
+	//calls tileFunction(tile, offset) for consecutive tiles of native floats
+	template<typename TileFunction>
+	void forEachFloatTile(std::span<const float> data, TileFunction&& tileFunction, std::size_t tileSize = defaultTileSize) {
 
-		constexpr std::uint8_t maxValue = {  std::numeric_limits<std::uint8_t>::max() };
-		std::uint8_t gray = maxValue * percent;
-		return rgb(gray, gray, gray);
+		for (std::size_t offset = 0; offset < data.size(); offset += tileSize)
+			tileFunction(data.subspan(offset, std::min(tileSize, data.size() - offset)), offset);
+	}
 
-		};
+	template<typename TileFunction>
+	void forEachFloatTile(const RawImage& data, TileFunction&& tileFunction, std::size_t tileSize = defaultTileSize) {
 
-	auto binary = [&](auto percent) {
+		//the decoded tile lives in L1 for as long as tileFunction works on it
+		thread_local std::vector<float> tile;
+		tile.resize(tileSize);
 
-		constexpr std::uint8_t maxValue = { std::numeric_limits<std::uint8_t>::max() };
-		//perrcent is between 0 and 1 so round to 0 or 1 and multiply by max value for either 0 or 255
-		std::uint8_t bit = std::round(percent);
-		std::uint8_t gray = maxValue * bit;
-		return rgb(gray, gray, gray);
+		for (std::size_t offset = 0; offset < data.size(); offset += tileSize) {
 
-		};
+			auto count = std::min(tileSize, data.size() - offset);
+			decodeRawPixels(data.subspan(offset, count), std::span<float>(tile.data(), count));
+
+			tileFunction(std::span<const float>(tile.data(), count), offset);
+		}
+	}
 
-	void floatSpaceConvert(std::span<const float> data, std::span<uint32_t> converted, ColorizeMode colorMode = ColorizeMode::NICKRGB, double vMin = 0.0, double vMax = 1.0, double stripeNum = 1) {
+	std::span<const float> subspanImage(std::span<const float> image, std::size_t offset, std::size_t count) {
+		return image.subspan(offset, count);
+	}
+	RawImage subspanImage(const RawImage& image, std::size_t offset, std::size_t count) {
+		return image.subspan(offset, count);
+	}
 
-		auto getViewWindow = [&](double startPercent = 0.0, double endPercent = 1.0) ->std::tuple<double, double, double> {
+	ImageStats computeImageStats(const RawImage& data) {
 
-			auto minmax = std::minmax_element(data.begin(), data.end()); 
-			auto min = *minmax.first, max = *minmax.second;
+		StatsAccumulator accumulator;
+		forEachFloatTile(data, [&](auto tile, auto) { accumulator.add(tile); });
+		return accumulator.stats();
+	}
 
-			double distance = max - min;
+	std::tuple<double, double, double> getViewWindow(const ImageStats& stats, double startPercent = 0.0, double endPercent = 1.0) {
 
-			double viewMin = min + distance * startPercent;
-			double viewMax = min + distance * endPercent;
-			double viewDistance = viewMax - viewMin;
+		double distance = stats.max - stats.min;
 
-			if (viewDistance == 0) viewDistance = 1;
+		double viewMin = stats.min + distance * startPercent;
+		double viewMax = stats.min + distance * endPercent;
+		double viewDistance = viewMax - viewMin;
 
-			return { viewMin, viewMax, viewDistance };
-		};
+		if (viewDistance == 0) viewDistance = 1;
 
-		auto [viewMin, viewMax, viewDistance] = getViewWindow(vMin, vMax);	//0,1 is full view window of data
+		return { viewMin, viewMax, viewDistance };
+	}
 
-		double stripeDistance = viewDistance / stripeNum;
+	//position of a value within its stripe of the view, 0 .. 1; NaN and values past the view are 1
+	double stripePercent(double f, double viewMin, double viewDistance, double stripeDistance) {
 
-		auto convertToGreyScale = [&](double f)->double {
+		double percent = 1.0;
 
-			double percent = 1.0;
+		f -= viewMin;
 
-			f -= viewMin;
+		if (f < viewDistance) {
+			f -= stripeDistance * std::floor(f / stripeDistance);
 
-			if (f < viewDistance) {
-				f -= stripeDistance * std::floor(f / stripeDistance);
+			percent = f / stripeDistance;
+		}
 
-				percent = f / stripeDistance;
-			}
+		//an infinite pixel or view gives a NaN percent, which takes the color of NaN pixels; the rest are held to 0 .. 1,
+		//so no colorize lambda, table or kernel converts a value outside its integer range
+		return std::isnan(percent) ? 1.0 : std::clamp(percent, 0.0, 1.0);
+	}
+
+	//colorizes data into converted for an already resolved view window and stripe distance, with pixels in channel order
+	template<ChannelOrder order = ChannelOrder::RGBA>
+	void colorizeSpan(std::span<const float> data, std::span<uint32_t> converted, ColorizeMode colorMode, double viewMin, double viewDistance, double stripeDistance, std::size_t lutSize = 0) {
 
-			//percent is between 0 and 1
-			return percent;
+		auto convertToGreyScale = [&](double f)->double {
+			return stripePercent(f, viewMin, viewDistance, stripeDistance);
 		};
 
 		auto setOpaque = [&](std::uint32_t& p) {
@@ -143,11 +244,28 @@ namespace FitsConverter {
 				//we want these pixels to be defined as completly non-transparent
 				setOpaque(rgba);
 				
-				return rgba;
+				return toChannelOrder<order>(rgba);
 
 				});
 			};
 
+		//table path: the nearest precomputed color replaces the colorize lambda and setOpaque
+		if (auto lut = getColorizeLut(colorMode, lutSize); !lut.empty()) {
+
+			const double lutScale = lut.size() - 1;
+
+			std::transform(std::execution::seq, data.begin(), data.end(), converted.begin(), [&](auto& f) {
+				//percents are already held to 0 .. 1, so nothing indexes past the table
+				return toChannelOrder<order>(lut[std::size_t(convertToGreyScale(f) * lutScale + 0.5)]);
+				});
+			return;
+		}
+
+		//the explicit simd kernels match the lambdas bit for bit and leave only the tail to them
+		auto simdCount = colorizeSpanSimd<order>(data, converted, colorMode, viewMin, viewDistance, stripeDistance);
+		data = data.subspan(simdCount);
+		converted = converted.subspan(simdCount);
+
 		switch (colorMode) {
 		case ColorizeMode::NICKRGB:{
 
@@ -181,141 +299,1381 @@ namespace FitsConverter {
 		}
 	}
 
-	void readFITSimagesAndColorize(const std::string& fileName) {
+	template<ChannelOrder order = ChannelOrder::RGBA>
+	void floatSpaceConvert(std::span<const float> data, std::span<uint32_t> converted, const ImageStats& stats, ColorizeMode colorMode = ColorizeMode::NICKRGB, double vMin = 0.0, double vMax = 1.0, double stripeNum = 1, std::size_t lutSize = 0) {
+
+		auto [viewMin, viewMax, viewDistance] = getViewWindow(stats, vMin, vMax);	//0,1 is full view window of data
+
+		colorizeSpan<order>(data, converted, colorMode, viewMin, viewDistance, viewDistance / stripeNum, lutSize);
+	}
+
+	//one requested output of a fused colorize pass
+	struct ColorizeVariant {
+
+		ColorizeMode colorMode = ColorizeMode::NICKRGB;
+		double stripeNum = 1;
+		std::span<uint32_t> converted;
+	};
+
+	//fused pass: each input tile is read once from memory and written to every variant while it is hot in cache
+	template<ChannelOrder order, typename Image>
+	void floatSpaceConvertTiles(const Image& data, std::span<const ColorizeVariant> variants, const ImageStats& stats, double vMin, double vMax, std::size_t lutSize, std::size_t tileSize) {
+
+		auto [viewMin, viewMax, viewDistance] = getViewWindow(stats, vMin, vMax);
+
+		forEachFloatTile(data, [&](std::span<const float> tile, std::size_t offset) {
+
+			for (auto& variant : variants)
+				colorizeSpan<order>(tile, variant.converted.subspan(offset, tile.size()), variant.colorMode, viewMin, viewDistance, viewDistance / variant.stripeNum, lutSize);
+
+			}, tileSize);
+	}
+
+	template<ChannelOrder order = ChannelOrder::RGBA>
+	void floatSpaceConvert(std::span<const float> data, std::span<const ColorizeVariant> variants, const ImageStats& stats, double vMin = 0.0, double vMax = 1.0, std::size_t lutSize = 0, std::size_t tileSize = defaultTileSize) {
+
+		floatSpaceConvertTiles<order>(data, variants, stats, vMin, vMax, lutSize, tileSize);
+	}
+
+	//fused decode and colorize for memory mapped HDUs: each tile is byte swapped, scaled, normalized and
+	//colorized while in L1, so no image sized float buffer is ever materialized
+	template<ChannelOrder order = ChannelOrder::RGBA>
+	void floatSpaceConvert(const RawImage& data, std::span<const ColorizeVariant> variants, const ImageStats& stats, double vMin = 0.0, double vMax = 1.0, std::size_t lutSize = 0, std::size_t tileSize = defaultTileSize) {
+
+		floatSpaceConvertTiles<order>(data, variants, stats, vMin, vMax, lutSize, tileSize);
+	}
+
+	//closes a read only fits file, also when a conversion throws; a failed close loses nothing, so its status is ignored
+	struct FitsCloser {
+
+		void operator()(fitsfile* fptr) const {
+
+			int status = 0;
+			fits_close_file(fptr, &status);
+		}
+	};
+	using FitsHandle = std::unique_ptr<fitsfile, FitsCloser>;
+
+	//BSCALE and BZERO of the current HDU, 1 and 0 when absent
+	std::pair<double, double> readScaling(fitsfile* fptr) {
+
+		double bscale = 1.0, bzero = 0.0;
+		int status = 0;
+
+		if (fits_read_key(fptr, TDOUBLE, "BSCALE", &bscale, nullptr, &status)) bscale = 1.0;
+		status = 0;
+		if (fits_read_key(fptr, TDOUBLE, "BZERO", &bzero, nullptr, &status)) bzero = 0.0;
+
+		return { bscale, bzero };
+	}
+
+	//an image stored as 16 bit indices into a table of the float values they stand for
+	struct IndexedImage {
+
+		std::vector<std::uint16_t> indices;
+		std::vector<float> values;
+
+		std::size_t size() const { return indices.size(); }
+	};
+
+	//index 65535 is reserved for NaN pixels so that they colorize exactly as in the float path
+	constexpr std::size_t quantizeLevels = std::numeric_limits<std::uint16_t>::max();
+
+	//fills the value table of indexed and returns the function that maps a pixel to its index
+	auto makeQuantizer(IndexedImage& indexed, const ImageStats& stats) {
+
+		indexed.values.resize(quantizeLevels + 1);
+
+		static constexpr double maxIndex = quantizeLevels - 1;
+
+		double distance = stats.max - stats.min;
+		double scale = (distance > 0 && std::isfinite(distance)) ? maxIndex / distance : 0.0;
+
+		for (std::size_t i = 0; i < quantizeLevels; ++i)
+			indexed.values[i] = scale > 0 ? stats.min + i / scale : stats.min;
+
+		//the ends are exact so that min and max pixels land on the same colors as in the float path
+		indexed.values.front() = stats.min;
+		indexed.values[quantizeLevels - 1] = stats.max;
+		indexed.values.back() = std::numeric_limits<float>::quiet_NaN();
+
+		return [min = stats.min, scale](float f)->std::uint16_t {
+
+			//an infinite pixel takes percent 1 in the float path under any view, the color of the NaN slot
+			if (!std::isfinite(f)) return quantizeLevels;
+
+			//an infinite range makes the index NaN, which goes to 0 like every pixel of a range with no scale
+			double index = (f - min) * scale + 0.5;
+			index = std::isnan(index) ? 0.0 : std::clamp(index, 0.0, maxIndex);
+			return index;
+			};
+	}
+
+	IndexedImage quantizeImage(std::span<const float> data, const ImageStats& stats) {
+
+		IndexedImage indexed;
+		auto quantize = makeQuantizer(indexed, stats);
+
+		indexed.indices.resize(data.size());
+		std::transform(std::execution::par_unseq, data.begin(), data.end(), indexed.indices.begin(), quantize);
+
+		return indexed;
+	}
+
+	IndexedImage quantizeImage(const RawImage& data, const ImageStats& stats) {
+
+		IndexedImage indexed;
+		auto quantize = makeQuantizer(indexed, stats);
+
+		indexed.indices.resize(data.size());
+		forEachFloatTile(data, [&](std::span<const float> tile, std::size_t offset) {
+			std::transform(tile.begin(), tile.end(), indexed.indices.begin() + offset, quantize);
+			});
+
+		return indexed;
+	}
+
+	//BITPIX 8 and 16 images are indexed by their raw value, shifted to be unsigned
+	bool isNativeInteger(int bitpix) {
+		return bitpix == BYTE_IMG || bitpix == SHORT_IMG;
+	}
+	std::uint16_t integerIndexOffset(int bitpix) {
+		return bitpix == SHORT_IMG ? 32768 : 0;
+	}
+
+	//the table of physical values of every raw integer, computed as cfitsio does for TFLOAT reads
+	IndexedImage makeIntegerIndexed(int bitpix, double bscale, double bzero) {
+
+		IndexedImage indexed;
+		indexed.values.resize(bitpix == SHORT_IMG ? 65536 : 256);
+
+		auto offset = integerIndexOffset(bitpix);
+		for (std::size_t i = 0; i < indexed.values.size(); ++i)
+			indexed.values[i] = (double(i) - offset) * bscale + bzero;
+
+		return indexed;
+	}
+
+	//reads a BITPIX 8 or 16 HDU as raw indices: with scaling overridden, cfitsio adds the index offset itself
+	IndexedImage readIndexedImage(fitsfile* fptr, int bitpix, std::size_t npixels, std::size_t chunkPixels = 0) {
+
+		auto [bscale, bzero] = readScaling(fptr);
+		auto indexed = makeIntegerIndexed(bitpix, bscale, bzero);
+
+		int status = 0, anynull = 0;
+		std::uint16_t nullval = 0;
+
+		fits_set_bscale(fptr, 1.0, integerIndexOffset(bitpix), &status);
+
+		indexed.indices.resize(npixels);
+
+		if (chunkPixels == 0) chunkPixels = npixels;
+
+		for (std::size_t offset = 0; offset < npixels; offset += chunkPixels) {
+
+			auto count = std::min(chunkPixels, npixels - offset);
+
+			if (fits_read_img(fptr, TUSHORT, offset + 1, count, &nullval, indexed.indices.data() + offset, &anynull, &status))
+				throw std::runtime_error("fits read");
+		}
+
+		//back to the header scaling for any later read of this HDU
+		fits_set_bscale(fptr, bscale, bzero, &status);
+
+		return indexed;
+	}
+
+	IndexedImage indexRawImage(const RawImage& image) {
+
+		auto indexed = makeIntegerIndexed(image.bitpix, image.bscale, image.bzero);
+		indexed.indices.resize(image.size());
+
+		auto indices = reinterpret_cast<std::byte*>(indexed.indices.data());
+
+		if (image.bitpix == SHORT_IMG) {
+
+			byteSwap<sizeof(std::int16_t)>(image.bytes.data(), indices, image.size());
+			for (auto& index : indexed.indices) index ^= 0x8000;
+
+		} else
+			std::copy(reinterpret_cast<const std::uint8_t*>(image.bytes.data()), reinterpret_cast<const std::uint8_t*>(image.bytes.data()) + image.size(), indexed.indices.begin());
+
+		return indexed;
+	}
+
+	//stats of an integer image from how many pixels hold each index, and the value of each index
+	ImageStats histogramStats(std::span<const float> values, std::span<const std::size_t> histogram) {
+
+		StatsAccumulator accumulator;
+		for (std::size_t i = 0; i < histogram.size(); ++i) {
+
+			if (histogram[i] == 0) continue;
+
+			float value = values[i];
+			accumulator.min = std::min(accumulator.min, value);
+			accumulator.max = std::max(accumulator.max, value);
+			accumulator.sum += double(value) * histogram[i];
+			accumulator.count += histogram[i];
+		}
+
+		return accumulator.stats();
+	}
+
+	//stats of an integer image from the histogram of its indices, no float pass needed
+	ImageStats computeImageStats(const IndexedImage& indexed) {
+
+		std::vector<std::size_t> histogram(indexed.values.size());
+		for (auto index : indexed.indices)
+			++histogram[index];
+
+		return histogramStats(indexed.values, histogram);
+	}
+
+	//colorizes the table of representative values, giving the color of every index in channel order
+	template<ChannelOrder order = ChannelOrder::RGBA>
+	std::vector<uint32_t> makeColorLut(std::span<const float> values, const ImageStats& stats, ColorizeMode colorMode, double vMin, double vMax, double stripeNum) {
+
+		std::vector<uint32_t> lut(values.size());
+		floatSpaceConvert<order>(values, lut, stats, colorMode, vMin, vMax, stripeNum);
+		return lut;
+	}
+
+	void indexSpaceConvert(std::span<const std::uint16_t> indices, std::span<uint32_t> converted, std::span<const uint32_t> lut) {
+
+		std::transform(std::execution::seq, indices.begin(), indices.end(), converted.begin(), [&](auto index) {
+			return lut[index];
+			});
+	}
+
+	//builds the lut of every variant up front, so that any part of the index plane can then be rendered on its own
+	template<ChannelOrder order = ChannelOrder::RGBA>
+	std::vector<std::vector<uint32_t>> makeColorLuts(std::span<const float> values, std::span<const ColorizeVariant> variants, const ImageStats& stats, double vMin = 0.0, double vMax = 1.0) {
+
+		std::vector<std::vector<uint32_t>> luts;
+		for (auto& variant : variants)
+			luts.push_back(makeColorLut<order>(values, stats, variant.colorMode, vMin, vMax, variant.stripeNum));
+		return luts;
+	}
+
+	//quantized counterpart of the fused floatSpaceConvert: a gather per pixel from the lut of each variant
+	void indexSpaceConvert(std::span<const std::uint16_t> indices, std::span<const ColorizeVariant> variants, std::span<const std::vector<uint32_t>> luts, std::size_t tileSize = defaultTileSize) {
+
+		for (std::size_t offset = 0; offset < indices.size(); offset += tileSize) {
+
+			auto count = std::min(tileSize, indices.size() - offset);
+			auto tile = indices.subspan(offset, count);
+
+			for (std::size_t v = 0; v < variants.size(); ++v)
+				indexSpaceConvert(tile, variants[v].converted.subspan(offset, count), luts[v]);
+		}
+	}
+
+	template<ChannelOrder order = ChannelOrder::RGBA>
+	void indexSpaceConvert(const IndexedImage& image, std::span<const ColorizeVariant> variants, const ImageStats& stats, double vMin = 0.0, double vMax = 1.0, std::size_t tileSize = defaultTileSize) {
+
+		auto luts = makeColorLuts<order>(image.values, variants, stats, vMin, vMax);
+		indexSpaceConvert(image.indices, variants, luts, tileSize);
+	}
+
+	//GREYSCALE and BINARY carry a byte and a bit per pixel, so they can be written in those packed formats
+	PixelFormat packedFormat(ColorizeMode colorMode) {
+
+		switch (colorMode) {
+		case ColorizeMode::GREYSCALE: return PixelFormat::GREY8;
+		case ColorizeMode::BINARY: return PixelFormat::BIT1;
+		default: return PixelFormat::COLOR32;
+		}
+	}
+
+	//one requested packed output: whole rows of GREY8 or BIT1 pixels
+	struct PackedVariant {
+
+		ColorizeMode colorMode = ColorizeMode::GREYSCALE;
+		double stripeNum = 1;
+		std::span<std::uint8_t> packed;
+
+		PixelFormat format() const { return packedFormat(colorMode); }
+	};
+
+	//GREYSCALE row as one byte per pixel: the grey channel of the color the 32 bit path produces
+	void greyRow(std::span<const float> row, std::span<std::uint8_t> grey, double viewMin, double viewDistance, double stripeDistance, std::size_t lutSize = 0) {
+
+		thread_local std::vector<std::uint32_t> colors;
+		colors.resize(row.size());
+
+		colorizeSpan(row, colors, ColorizeMode::GREYSCALE, viewMin, viewDistance, stripeDistance, lutSize);
+
+		std::transform(colors.begin(), colors.end(), grey.begin(), [](auto rgba) { return std::uint8_t(rgba); });
+	}
+
+	//BINARY row as one bit per pixel, most significant first; white where the percent rounds to 1
+	void binaryRow(std::span<const float> row, std::span<std::uint8_t> bits, double viewMin, double viewDistance, double stripeDistance) {
+
+		auto done = packBinarySimd(row, bits.data(), viewMin, viewDistance, stripeDistance);
+
+		std::fill(bits.begin() + done / 8, bits.end(), std::uint8_t(0));
+		for (std::size_t i = done; i < row.size(); ++i)
+			if (std::round(stripePercent(row[i], viewMin, viewDistance, stripeDistance)) == 1.0)
+				bits[i / 8] |= std::uint8_t(0x80 >> (i % 8));
+	}
+
+	//packed counterpart of the fused floatSpaceConvert for a band of whole rows; tiles are whole rows, so a raw band
+	//is still decoded a few rows at a time
+	template<typename Image>
+	void packSpaceConvert(const Image& data, std::size_t width, std::span<const PackedVariant> variants, const ImageStats& stats, double vMin = 0.0, double vMax = 1.0, std::size_t lutSize = 0) {
+
+		auto [viewMin, viewMax, viewDistance] = getViewWindow(stats, vMin, vMax);
+
+		std::size_t tileRows = std::max<std::size_t>(1, defaultTileSize / width);
+
+		forEachFloatTile(data, [&](std::span<const float> tile, std::size_t offset) {
+
+			for (std::size_t r = 0; r < tile.size() / width; ++r) {
+
+				auto row = tile.subspan(r * width, width);
+				auto rowIndex = offset / width + r;
+
+				for (auto& variant : variants) {
+
+					auto rowBytes = pixelFormatRowBytes(variant.format(), width);
+					auto packed = variant.packed.subspan(rowIndex * rowBytes, rowBytes);
+					auto stripeDistance = viewDistance / variant.stripeNum;
+
+					if (variant.format() == PixelFormat::BIT1)
+						binaryRow(row, packed, viewMin, viewDistance, stripeDistance);
+					else
+						greyRow(row, packed, viewMin, viewDistance, stripeDistance, lutSize);
+				}
+			}
+			}, tileRows * width);
+	}
+
+	//the color tables of the packed variants, for rendering them from an index plane
+	std::vector<std::vector<uint32_t>> makePackedLuts(std::span<const float> values, std::span<const PackedVariant> variants, const ImageStats& stats, double vMin = 0.0, double vMax = 1.0) {
+
+		std::vector<std::vector<uint32_t>> luts;
+		for (auto& variant : variants)
+			luts.push_back(makeColorLut(values, stats, variant.colorMode, vMin, vMax, variant.stripeNum));
+		return luts;
+	}
+
+	//quantized counterpart of packSpaceConvert: the packed pixel is read off the color each index maps to
+	void packIndexConvert(std::span<const std::uint16_t> indices, std::size_t width, std::span<const PackedVariant> variants, std::span<const std::vector<uint32_t>> luts) {
+
+		for (std::size_t v = 0; v < variants.size(); ++v) {
+
+			auto& lut = luts[v];
+			auto format = variants[v].format();
+			auto rowBytes = pixelFormatRowBytes(format, width);
+
+			for (std::size_t row = 0; row < indices.size() / width; ++row) {
+
+				auto rowIndices = indices.subspan(row * width, width);
+				auto packed = variants[v].packed.subspan(row * rowBytes, rowBytes);
+
+				if (format == PixelFormat::BIT1) {
+
+					std::fill(packed.begin(), packed.end(), std::uint8_t(0));
+					for (std::size_t i = 0; i < width; ++i)
+						if (lut[rowIndices[i]] & 0xFF)
+							packed[i / 8] |= std::uint8_t(0x80 >> (i % 8));
+				} else
+					std::transform(rowIndices.begin(), rowIndices.end(), packed.begin(), [&](auto index) { return std::uint8_t(lut[index]); });
+			}
+		}
+	}
+
+	//the rows firstRow .. firstRow + rowCount of every packed variant
+	std::vector<PackedVariant> subspanPackedVariants(std::span<const PackedVariant> variants, std::size_t width, std::size_t firstRow, std::size_t rowCount) {
+
+		std::vector<PackedVariant> band(variants.begin(), variants.end());
+		for (auto& variant : band) {
+
+			auto rowBytes = pixelFormatRowBytes(variant.format(), width);
+			variant.packed = variant.packed.subspan(firstRow * rowBytes, rowCount * rowBytes);
+		}
+		return band;
+	}
+
+	//the part of every variant that covers pixels offset .. offset + count
+	std::vector<ColorizeVariant> subspanVariants(std::span<const ColorizeVariant> variants, std::size_t offset, std::size_t count) {
+
+		std::vector<ColorizeVariant> band(variants.begin(), variants.end());
+		for (auto& variant : band)
+			variant.converted = variant.converted.subspan(offset, count);
+		return band;
+	}
+
+	//reads the current HDU straight into image with one cfitsio call per chunk; chunkPixels 0 reads it in one call
+	void readImage(fitsfile* fptr, std::size_t npixels, std::vector<float>& image, std::size_t chunkPixels = 0) {
+
+		int status = 0, anynull = 0;
+		float nullval = 0;
+
+		image.resize(npixels);
+
+		if (chunkPixels == 0) chunkPixels = npixels;
+
+		for (std::size_t offset = 0; offset < npixels; offset += chunkPixels) {
+
+			auto count = std::min(chunkPixels, npixels - offset);
+
+			if (fits_read_img(fptr, TFLOAT, offset + 1, count, &nullval, image.data() + offset, &anynull, &status))
+				throw std::runtime_error("fits read");
+		}
+	}
+
+	//reads the whole rows that fit in rows, starting at firstRow, in one cfitsio call
+	void readImageRows(fitsfile* fptr, std::size_t firstRow, std::span<float> rows) {
+
+		int status = 0, anynull = 0;
+		float nullval = 0;
+
+		LONGLONG firstPixel[2] = { 1, LONGLONG(firstRow) + 1 };
+
+		if (fits_read_pixll(fptr, TFLOAT, firstPixel, rows.size(), &nullval, rows.data(), &anynull, &status))
+			throw std::runtime_error("fits read");
+	}
+
+	//the same rows of a BITPIX 8 or 16 HDU as raw indices, read as readIndexedImage does
+	void readIndexedRows(fitsfile* fptr, int bitpix, std::pair<double, double> scaling, std::size_t firstRow, std::span<std::uint16_t> rows) {
+
+		int status = 0, anynull = 0;
+		std::uint16_t nullval = 0;
+
+		LONGLONG firstPixel[2] = { 1, LONGLONG(firstRow) + 1 };
+
+		fits_set_bscale(fptr, 1.0, integerIndexOffset(bitpix), &status);
+		fits_read_pixll(fptr, TUSHORT, firstPixel, rows.size(), &nullval, rows.data(), &anynull, &status);
+
+		//back to the header scaling, even when the read failed
+		int scaleStatus = 0;
+		fits_set_bscale(fptr, scaling.first, scaling.second, &scaleStatus);
+
+		if (status)
+			throw std::runtime_error("fits read");
+	}
+
+	//DATAMIN and DATAMAX of the current HDU, when the header has both
+	std::optional<std::pair<double, double>> readDataRange(fitsfile* fptr) {
+
+		double dataMin, dataMax;
+		int status = 0;
+
+		fits_read_key(fptr, TDOUBLE, "DATAMIN", &dataMin, nullptr, &status);
+		fits_read_key(fptr, TDOUBLE, "DATAMAX", &dataMax, nullptr, &status);
+
+		if (status || !(dataMin < dataMax)) return {};
+
+		return std::make_pair(dataMin, dataMax);
+	}
+
+	//the original 1000 float buffer loop, kept as the baseline for benchmarkRead
+	void readImageBuffered(fitsfile* fptr, std::size_t npixels, std::vector<float>& image) {
+
+		int status = 0, anynull = 0;
+		float nullval = 0;
+
+		constexpr std::size_t buffsize = 1000;
+		float buffer[buffsize];
+
+		image.clear();
+		image.reserve(npixels);
+
+		for (std::size_t fpixel = 1; npixels > 0; ) {
+
+			auto nbuffer = std::min(npixels, buffsize);
 
-		auto writeColorizedImages = [&](auto idx, auto& image, auto width, auto height) {
+			if (fits_read_img(fptr, TFLOAT, fpixel, nbuffer, &nullval, buffer, &anynull, &status))
+				throw std::runtime_error("fits read");
+
+			for (std::size_t ii = 0; ii < nbuffer; ii++)
+				image.push_back(buffer[ii]);
+
+			npixels -= nbuffer;
+			fpixel += nbuffer;
+		}
+	}
+
+	//the data block of the current HDU inside the mapped file, when it can be decoded directly:
+	//an uncompressed integer or float image in a plain (not gzipped) fits file
+	std::optional<RawImage> mapImage(fitsfile* fptr, const MappedFile& mapped, int bitpix, std::size_t npixels) {
+
+		auto bytes = mapped.bytes();
+
+		constexpr std::string_view fitsMagic = "SIMPLE  =";
+		if (bytes.size() < fitsMagic.size() || std::memcmp(bytes.data(), fitsMagic.data(), fitsMagic.size()) != 0)
+			return {};
+
+		switch (bitpix) {
+		case BYTE_IMG: case SHORT_IMG: case LONG_IMG: case FLOAT_IMG: case DOUBLE_IMG: break;
+		default: return {};
+		}
+
+		int status = 0;
+		if (fits_is_compressed_image(fptr, &status))
+			return {};
+
+		LONGLONG headStart, dataStart, dataEnd;
+		if (fits_get_hduaddrll(fptr, &headStart, &dataStart, &dataEnd, &status))
+			return {};
+
+		RawImage image;
+		image.bitpix = bitpix;
+		std::tie(image.bscale, image.bzero) = readScaling(fptr);
+
+		std::size_t size = npixels * image.pixelSize();
+		if (dataStart < 0 || std::size_t(dataStart) + size > bytes.size())
+			return {};
+
+		image.bytes = bytes.subspan(dataStart, size);
+		return image;
+	}
+
+	enum class OutputFormat {
+		BMP,
+		PNG
+	};
+
+	const char* outputFormatStr(OutputFormat format) {
+		switch (format) {
+		case OutputFormat::BMP: return "bmp";
+		case OutputFormat::PNG: return "png";
+		}
+		return "unknown";
+	}
+
+	//calls function with the channel order the writer of format stores, as a std::integral_constant,
+	//so that a runtime format can pick among the compile time colorizers
+	template<typename Function>
+	void visitChannelOrder(OutputFormat format, Function&& function) {
+
+		switch (format) {
+		case OutputFormat::BMP: function(std::integral_constant<ChannelOrder, bmpChannelOrder>{}); break;
+		case OutputFormat::PNG: function(std::integral_constant<ChannelOrder, pngChannelOrder>{}); break;
+		}
+	}
+
+	struct ConvertOptions {
+
+		//normalize each HDU once into a uint16 index plane and render every variant by lut lookup;
+		//colors are exact for the min, max and NaN pixels and quantized to 65534 levels in between
+		bool quantize = false;
+
+		//colorize through the constexpr tables of this size (4096 or 65536) instead of the lambdas;
+		//percents are rounded to the nearest table entry
+		std::size_t colorizeLutSize = 0;
+
+		//pool that runs the band tasks of every HDU; nullptr uses defaultThreadPool
+		ThreadPool* threadPool = nullptr;
+
+		//image rows per band task; 0 sizes bands to about 64K pixels
+		std::size_t bandRows = 0;
+
+		//pixels per fits_read_img call; 0 reads each HDU in a single call
+		std::size_t readChunkPixels = 0;
+
+		//decode and colorize uncompressed HDUs straight from a memory mapping of the file instead of reading them
+		bool memoryMap = false;
+
+		//render BITPIX 8 and 16 HDUs by direct lookup from raw value to color, with the scaling folded into the tables;
+		//the output is identical to the float path
+		bool nativeInteger = true;
+
+		//HDUs a reader thread may decode ahead of the one being colorized; 0 reads and colorizes in turn.
+		//at 1 the next HDU is decoded while the current one is colorized, holding two HDUs in memory
+		std::size_t prefetchDepth = 1;
+
+		//HDUs converted at once, each on its own thread with its own cfitsio handle; 0 uses one per hardware thread.
+		//at 1 HDUs are converted in turn and prefetchDepth applies
+		std::size_t hduThreads = 1;
+
+		//bytes of pixel buffers one HDU may use, split between hduThreads; 0 is unlimited.
+		//HDUs that would need more are streamed in row bands straight to their output files instead of being read whole,
+		//and a budget turns prefetch off since it would hold whole HDUs. it also caps the idle pooled buffers kept for later HDUs
+		std::size_t memoryBudget = 0;
+
+		//save bmps through FreeImage, colorizing into pooled FIBITMAPs, instead of writing the colorize buffers directly
+		bool freeImageBmp = false;
+
+		OutputFormat outputFormat = OutputFormat::BMP;
+
+		//write GREYSCALE as 8 bit grey and BINARY as 1 bit black and white images, a quarter and a 32nd of the 32 bit size;
+		//these always go through the built in writers
+		bool packedOutputs = true;
+
+		//zlib level of png output, 0 (stored) to 9; strips of every image are deflated in parallel
+		int pngLevel = Z_DEFAULT_COMPRESSION;
+
+		//caps on the fits reads and output file writes in progress at once, shared by every conversion given the same gate,
+		//such as the files of a batch; nullptr is no cap
+		IoGate* readGate = nullptr;
+		IoGate* writeGate = nullptr;
+	};
+
+	//one output image of every converted HDU: a colorize mode at a stripe count over a view window, in a file format.
+	//the window is given in fractions of the HDU's data range
+	struct OutputSpec {
+
+		ColorizeMode colorMode = ColorizeMode::ROYGBIV;
+		int stripes = 1;
+		double viewMin = 0.0, viewMax = 1.0;
+		OutputFormat format = OutputFormat::BMP;
+
+		bool operator==(const OutputSpec&) const = default;
+	};
+
+	//every colorize mode at 1, 2, 10, 20, 50 and 100 stripes over the whole range
+	std::vector<OutputSpec> defaultOutputs(OutputFormat format = OutputFormat::BMP) {
+
+		std::vector<OutputSpec> outputs;
+		for (auto stripes : { 1,2,10,20,50,100 })
+			for (auto colorizeMode : { ColorizeMode::GREYSCALE, ColorizeMode::ROYGBIV, ColorizeMode::NICKRGB, ColorizeMode::BINARY, ColorizeMode::SHORTNRGB })
+				outputs.push_back({ colorizeMode, stripes, 0.0, 1.0, format });
+		return outputs;
+	}
+
+	//{fits file}_{hdu}_{mode}_{stripes}.{format}, with the view window appended when it is not the whole range
+	std::string outputFileName(const std::string& fileName, std::size_t idx, const OutputSpec& output) {
+
+		auto window = output.viewMin == 0.0 && output.viewMax == 1.0 ? std::string() : std::format("_{}-{}", output.viewMin, output.viewMax);
+		return std::format("{}_{}_{}_{}{}.{}", fileName, idx, colorizeModeStr(output.colorMode), output.stripes, window, outputFormatStr(output.format));
+	}
+
+	std::vector<std::string> outputFileNames(const std::string& fileName, std::size_t idx, std::span<const OutputSpec> outputs) {
+
+		std::vector<std::string> names;
+		for (auto& output : outputs)
+			names.push_back(outputFileName(fileName, idx, output));
+		return names;
+	}
+
+	//bytes of height rows of every output as the colorizers produce them, packed or 32 bit
+	std::size_t outputImageBytes(std::span<const OutputSpec> outputs, std::size_t width, std::size_t height, bool packedOutputs) {
+
+		std::size_t bytes = 0;
+		for (auto& output : outputs)
+			bytes += pixelFormatRowBytes(packedOutputs ? packedFormat(output.colorMode) : PixelFormat::COLOR32, width) * height;
+		return bytes;
+	}
+
+	//exactly which outputs to produce from a fits file, and for which HDUs
+	struct ConversionJob {
+
+		std::string fileName;
+		std::vector<OutputSpec> outputs = defaultOutputs();
+
+		//HDU indices as in the output file names, the cfitsio HDU number less one; empty converts every image HDU
+		std::vector<std::size_t> hdus;
+
+		ConvertOptions options;
+	};
+
+	//outputs rendered by one fused pass over an HDU, sharing a format (and so a channel order) and a view window
+	struct ColorizePass {
+
+		OutputFormat format = OutputFormat::BMP;
+		double viewMin = 0.0, viewMax = 1.0;
+		std::vector<OutputSpec> outputs;
+	};
+
+	//groups the distinct outputs by format and window in the order they are first asked for,
+	//in passes of at most passOutputs, which bounds the output buffers alive at once
+	std::vector<ColorizePass> planColorizePasses(std::span<const OutputSpec> outputs, std::size_t passOutputs = 5) {
+
+		std::vector<ColorizePass> passes;
+		std::vector<OutputSpec> planned;
+
+		for (auto& output : outputs) {
+
+			if (output.stripes < 1 || !(output.viewMin >= 0.0 && output.viewMin < output.viewMax && output.viewMax <= 1.0))
+				throw std::runtime_error("invalid output");
+
+			if (std::ranges::find(planned, output) != planned.end()) continue;
+			planned.push_back(output);
+
+			auto pass = std::ranges::find_if(passes, [&](const ColorizePass& pass) {
+				return pass.format == output.format && pass.viewMin == output.viewMin && pass.viewMax == output.viewMax && pass.outputs.size() < passOutputs;
+				});
+
+			if (pass == passes.end())
+				pass = passes.insert(passes.end(), { output.format, output.viewMin, output.viewMax, {} });
+
+			pass->outputs.push_back(output);
+		}
+		return passes;
+	}
+
+	//one decoded HDU waiting to be colorized, in whichever form its read path produced
+	struct HduImage {
+
+		std::size_t idx = 0, width = 0, height = 0;
+		std::variant<std::vector<float>, RawImage, IndexedImage> image;
+		ImageStats stats;
+	};
+
+	//what a conversion produced
+	struct ConversionResult {
+
+		std::size_t hdus = 0, pixels = 0, outputs = 0;
+	};
+
+	//converts the HDUs of the job to its outputs; each HDU is read and its stats computed once,
+	//and every output only takes its share of the fused passes
+	ConversionResult runConversionJob(const ConversionJob& job) {
+
+		auto& fileName = job.fileName;
+		auto& options = job.options;
+
+		auto passes = planColorizePasses(job.outputs);
+		if (passes.empty()) return {};
+
+		//the idle buffers and bitmaps kept for later HDUs count against the memory budget too
+		if (options.memoryBudget) {
+			BufferPool::limitCachedBytes(options.memoryBudget);
+			if (options.freeImageBmp) bitmapPool().limitUnusedBytes(options.memoryBudget);
+		}
+
+		std::size_t outputCount = 0;
+		for (auto& pass : passes)
+			outputCount += pass.outputs.size();
+
+		//HDUs finish on several threads when hduThreads is above 1
+		std::atomic<std::size_t> convertedHdus = 0, convertedPixels = 0;
+
+		std::size_t passOutputs = std::ranges::max(passes, {}, [](const ColorizePass& pass) { return pass.outputs.size(); }).outputs.size();
+
+		auto writeColorizedImages = [&](auto idx, auto& image, const ImageStats& stats, auto width, auto height) {
 
 			if (image.size() == 0) return;
 
-			auto saveToBmpFile = [&](std::string fileName, std::span<uint32_t> image) {
+			auto& pool = options.threadPool ? *options.threadPool : defaultThreadPool();
 
-				uint8_t* bytes = reinterpret_cast<uint8_t*>(image.data());
-				//converted data are four byte type (int32)
-				//r g b a
+			//row bands are the unit of parallel work, so a single HDU keeps every worker busy
+			std::size_t bandRows = options.bandRows ? options.bandRows : std::max<std::size_t>(1, (1 << 16) / width);
+			std::size_t bandSize = bandRows * width;
 
-				int pitch = width * (32 / 8);
+			//integer HDUs arrive already indexed, float HDUs are quantized on request;
+			//either plane is shared read-only by every band task
+			constexpr bool nativeIndexed = std::is_same_v<std::remove_cvref_t<decltype(image)>, IndexedImage>;
 
-				//freeimage is writing in bgra format
-				auto bgra = [&](std::uint32_t rgba) {
+			IndexedImage quantized;
+			const IndexedImage* indexed = nullptr;
 
-					std::uint32_t tmp = rgba;
-					std::uint8_t* bytes = reinterpret_cast<std::uint8_t*>(&tmp);
-					std::swap(bytes[0], bytes[2]);
+			if constexpr (nativeIndexed)
+				indexed = &image;
+			else if (options.quantize) {
+				FITSCONVERTER_PROBE(quantizeProbe, fileName, idx, "quantize", image.size(), image.size() * sizeof(std::uint16_t));
+				quantized = quantizeImage(image, stats);
+				indexed = &quantized;
+			}
 
-					return tmp;
-					};
+			//the images of one pass are saved while the next one is colorized
+			struct PassOutputs {
 
-				std::transform(image.begin(), image.end(), image.begin(), bgra);
+				std::vector<BufferPool::Buffer> buffers;
+				std::vector<BitmapPool::Bitmap> bitmaps;
+				std::unique_ptr<TaskGroup> saves;
+			};
+			std::deque<PassOutputs> inFlight;
+
+			for (auto& pass : passes) {
+
+				//at most two passes worth of output buffers are alive
+				if (inFlight.size() == 2) {
+					inFlight.front().saves->wait();
+					inFlight.pop_front();
+				}
+
+				auto& outputs = inFlight.emplace_back(PassOutputs{ {}, {}, std::make_unique<TaskGroup>(pool) });
+
+				//one buffer per output, each band fills all of them in a single fused pass;
+				//grey and binary buffers hold bytes and bits when packed outputs are on.
+				//the output buffers come from the pools, so past the first HDU of a size they are reused rather than allocated,
+				//and bmps saved through freeimage are colorized straight into their FIBITMAPs.
+				//the color tables and quantized indices of indexed HDUs are still made for every HDU
+				bool freeImageOutputs = options.freeImageBmp && pass.format == OutputFormat::BMP;
+
+				std::vector<ColorizeVariant> variants;
+				std::vector<PackedVariant> packedVariants;
+				std::vector<std::string> variantNames, packedNames;
+				for (auto& output : pass.outputs) {
+
+					if (options.packedOutputs && packedFormat(output.colorMode) != PixelFormat::COLOR32) {
 
-				//correct byte order for free image write
-				FIBITMAP* convertedImage = FreeImage_ConvertFromRawBits(bytes, width, height, pitch, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+						auto [buffer, packed] = BufferPool::acquire<std::uint8_t>(pixelFormatRowBytes(packedFormat(output.colorMode), width) * height);
+						outputs.buffers.push_back(std::move(buffer));
+						packedVariants.push_back({ output.colorMode, double(output.stripes), packed });
+						packedNames.push_back(outputFileName(fileName, idx, output));
 
-				FreeImage_Save(FIF_BMP, convertedImage, fileName.c_str(), 0);
+					} else {
 
-				FreeImage_Unload(convertedImage);
-				};
+						if (freeImageOutputs) {
 
-			auto fileNameWithIdx = std::format("{}_{}", fileName, idx);
+							auto& bitmap = outputs.bitmaps.emplace_back(bitmapPool().acquire(width, height));
+							variants.push_back({ output.colorMode, double(output.stripes), bitmap.pixels() });
 
-			auto stripes = { 1,2,10,20,50,100 };
-			auto colorizeModes = { ColorizeMode::GREYSCALE, ColorizeMode::ROYGBIV, ColorizeMode::NICKRGB, ColorizeMode::BINARY, ColorizeMode::SHORTNRGB };
+						} else {
 
-			auto colorizeModeStr = [&](auto colorizeMode) {
-				switch (colorizeMode) {
-				case ColorizeMode::NICKRGB: return "nickrgb";
-				case ColorizeMode::ROYGBIV: return "roygbiv";
-				case ColorizeMode::GREYSCALE: return "greyscale";
-				case ColorizeMode::BINARY: return "binary";
-				case ColorizeMode::SHORTNRGB: return "snrgb";
+							auto [buffer, converted] = BufferPool::acquire<uint32_t>(image.size());
+							outputs.buffers.push_back(std::move(buffer));
+							variants.push_back({ output.colorMode, double(output.stripes), converted });
+						}
+						variantNames.push_back(outputFileName(fileName, idx, output));
+					}
+				}
+
+				std::vector<std::vector<uint32_t>> luts, packedLuts;
+				if (indexed) {
+					FITSCONVERTER_PROBE(lutProbe, fileName, idx, "lut", indexed->values.size() * pass.outputs.size(), 0, outputFileNames(fileName, idx, pass.outputs));
+					visitChannelOrder(pass.format, [&](auto order) {
+						luts = makeColorLuts<decltype(order)::value>(indexed->values, variants, stats, pass.viewMin, pass.viewMax);
+						});
+					packedLuts = makePackedLuts(indexed->values, packedVariants, stats, pass.viewMin, pass.viewMax);
 				}
-				return "unknown";
-				};
 
-			FreeImage_Initialise();
+				{
+					FITSCONVERTER_PROBE(colorizeProbe, fileName, idx, "colorize", image.size() * pass.outputs.size(),
+						outputImageBytes(pass.outputs, width, height, options.packedOutputs), outputFileNames(fileName, idx, pass.outputs));
+
+					TaskGroup bands(pool);
+					for (std::size_t offset = 0; offset < image.size(); offset += bandSize) {
 
-			std::for_each(std::execution::par, stripes.begin(), stripes.end(), [&](int stripeNum) {
+						bands.run([&, offset]() {
 
-				std::vector<uint32_t> converted(image.size());
+							FITSCONVERTER_PROBE_TASK(colorizeProbe);
 
-				for (auto colorizeMode : colorizeModes) {
+							auto count = std::min(bandSize, image.size() - offset);
+							auto bandVariants = subspanVariants(variants, offset, count);
+							auto bandPacked = subspanPackedVariants(packedVariants, width, offset / width, count / width);
 
-					floatSpaceConvert(image, converted, colorizeMode, 0.0f, 1.0f, stripeNum);
+							if (indexed) {
 
-					auto completeFileNameWithColorMode = std::format("{}_{}_{}.bmp", fileNameWithIdx, colorizeModeStr(colorizeMode), stripeNum);
-					saveToBmpFile(completeFileNameWithColorMode, converted);
+								auto indices = std::span<const std::uint16_t>(indexed->indices).subspan(offset, count);
+								indexSpaceConvert(indices, bandVariants, luts);
+								packIndexConvert(indices, width, bandPacked, packedLuts);
+
+							} else if constexpr (!nativeIndexed) {
+
+								visitChannelOrder(pass.format, [&](auto order) {
+									floatSpaceConvert<decltype(order)::value>(subspanImage(image, offset, count), bandVariants, stats, pass.viewMin, pass.viewMax, options.colorizeLutSize);
+									});
+								packSpaceConvert(subspanImage(image, offset, count), width, bandPacked, stats, pass.viewMin, pass.viewMax, options.colorizeLutSize);
+							}
+							});
+					}
+					bands.wait();
 				}
 
-				});
+				for (std::size_t i = 0; i < variants.size(); ++i)
+					outputs.saves->run([&, variant = variants[i], bitmap = freeImageOutputs ? outputs.bitmaps[i].get() : nullptr, completeFileNameWithColorMode = variantNames[i]]() {
+
+						FITSCONVERTER_PROBE(writeProbe, fileName, idx, "write", width * height, 0, { completeFileNameWithColorMode });
+						FITSCONVERTER_PROBE_TASK(writeProbe);
+
+						if (pass.format == OutputFormat::PNG)
+							writePngFile(completeFileNameWithColorMode, width, height, variant.converted, pool, options.pngLevel, options.writeGate, FITSCONVERTER_PROBE_POINTER(writeProbe));
+						else if (bitmap) {
+							auto slot = IoGate::enter(options.writeGate);
+							FreeImage_Save(FIF_BMP, bitmap, completeFileNameWithColorMode.c_str(), 0);
+						}
+						else
+							writeBmpFile(completeFileNameWithColorMode, width, height, variant.converted, options.writeGate);
+
+						FITSCONVERTER_PROBE_BYTES(writeProbe, std::filesystem::file_size(completeFileNameWithColorMode));
+						});
 
-			FreeImage_DeInitialise();
+				for (std::size_t i = 0; i < packedVariants.size(); ++i)
+					outputs.saves->run([&, variant = packedVariants[i], completeFileNameWithColorMode = packedNames[i]]() {
+
+						FITSCONVERTER_PROBE(writeProbe, fileName, idx, "write", width * height, 0, { completeFileNameWithColorMode });
+						FITSCONVERTER_PROBE_TASK(writeProbe);
+
+						if (pass.format == OutputFormat::PNG)
+							writePngFile(completeFileNameWithColorMode, width, height, variant.packed, variant.format(), pool, options.pngLevel, options.writeGate, FITSCONVERTER_PROBE_POINTER(writeProbe));
+						else
+							writeBmpFile(completeFileNameWithColorMode, width, height, variant.packed, variant.format(), options.writeGate);
+
+						FITSCONVERTER_PROBE_BYTES(writeProbe, std::filesystem::file_size(completeFileNameWithColorMode));
+						});
+			}
 
+			for (; !inFlight.empty(); inFlight.pop_front())
+				inFlight.front().saves->wait();
 			};
 
-		auto readFitsImages = [&]() {
+		auto openFits = [&]() {
 
 			fitsfile* fptr;
-			int status, nfound, anynull, bitpix, naxis;
-			long naxes[10], fpixel, nbuffer, npixels, ii;
+			int status = 0;
 
-			constexpr long buffsize = 1000;
-			float nullval, buffer[buffsize];
+			if (fits_open_file(&fptr, fileName.c_str(), READONLY, &status))
+				throw std::runtime_error("failed to open fits");
 
-			status = 0;
+			return FitsHandle(fptr);
+		};
 
-			if (fits_open_file(&fptr, fileName.c_str(), READONLY, &status))
-				throw std::exception("failed to open fits");
+		std::unique_ptr<MappedFile> mapped;
+		if (options.memoryMap)
+			mapped = std::make_unique<MappedFile>(fileName);
 
-			std::size_t idx = 0;
-			std::vector<float> image;
-			do {
+		//decodes the current HDU of fptr along the path the options ask for, with the stats all its passes share
+		auto readHdu = [&](fitsfile* fptr, std::size_t idx, int bitpix, std::size_t width, std::size_t height) {
+
+			HduImage hdu;
+			hdu.idx = idx;
+			hdu.width = width;
+			hdu.height = height;
+
+			auto view = mapped ? mapImage(fptr, *mapped, bitpix, width * height) : std::nullopt;
 
-				fpixel = 1;
-				nullval = 0;
+			if (options.nativeInteger && isNativeInteger(bitpix)) {
 
-				fits_get_img_param(fptr, 10, &bitpix, &naxis, naxes, &status);
+				IndexedImage indexed;
+				{
+					FITSCONVERTER_PROBE(readProbe, fileName, idx, "read", width * height, width * height * std::abs(bitpix) / 8);
+					if (view)
+						indexed = indexRawImage(*view);
+					else {
+						auto slot = IoGate::enter(options.readGate);
+						indexed = readIndexedImage(fptr, bitpix, width * height, options.readChunkPixels);
+					}
+				}
+				{
+					FITSCONVERTER_PROBE(statsProbe, fileName, idx, "stats", indexed.size(), indexed.size() * sizeof(std::uint16_t));
+					hdu.stats = computeImageStats(indexed);
+				}
+				hdu.image = std::move(indexed);
+
+			} else if (view) {
+
+				//the mapped pixels are decoded as the stats and colorize passes reach them, so the read is part of both
+				{
+					FITSCONVERTER_PROBE(statsProbe, fileName, idx, "stats", view->size(), view->bytes.size());
+					hdu.stats = computeImageStats(*view);
+				}
+				hdu.image = *view;
+
+			} else {
+
+				std::vector<float> image;
+				{
+					FITSCONVERTER_PROBE(readProbe, fileName, idx, "read", width * height, width * height * std::abs(bitpix) / 8);
+					auto slot = IoGate::enter(options.readGate);
+					readImage(fptr, width * height, image, options.readChunkPixels);
+				}
+				{
+					FITSCONVERTER_PROBE(statsProbe, fileName, idx, "stats", image.size(), image.size() * sizeof(float));
+					hdu.stats = computeImageStats(image);
+				}
+				hdu.image = std::move(image);
+			}
+			return hdu;
+		};
+
+		auto colorizeHdu = [&](HduImage& hdu) {
+
+			std::visit([&](auto& image) {
+				writeColorizedImages(hdu.idx, image, hdu.stats, hdu.width, hdu.height);
+				}, hdu.image);
+
+			++convertedHdus;
+			convertedPixels += hdu.width * hdu.height;
+			FITSCONVERTER_PROFILE_HDU(hdu.width * hdu.height);
+			return true;
+		};
 
-				if (naxis != 0) {
+		//converts an HDU too large for the memory budget a band of rows at a time, appending each band to every output file;
+		//min/max come from DATAMIN/DATAMAX, or else from a first pass over the bands.
+		//BITPIX 8 and 16 bands are read as raw indices and colorized through the tables of their values, as readHdu does for whole HDUs
+		auto streamHdu = [&](fitsfile* fptr, std::size_t idx, int bitpix, std::size_t width, std::size_t height, std::size_t budget) {
 
-					std::size_t width = naxes[0], height = naxes[1];
-					npixels = width * height;
+			auto& pool = options.threadPool ? *options.threadPool : defaultThreadPool();
 
-					image.reserve(width * height);
-					image.clear();
+			//a band holds its floats and the rgba rows of every output
+			std::size_t bandRows = std::clamp<std::size_t>(budget / (width * (sizeof(float) + outputCount * sizeof(std::uint32_t))), 1, height);
+			std::size_t bandPixels = bandRows * width;
 
-					while (npixels > 0) {
+			bool nativeIndexed = options.nativeInteger && isNativeInteger(bitpix);
+			auto scaling = readScaling(fptr);
+			auto indexed = nativeIndexed ? makeIntegerIndexed(bitpix, scaling.first, scaling.second) : IndexedImage{};
 
-						nbuffer = npixels;
-						if (npixels > buffsize)
-							nbuffer = buffsize;
+			std::vector<float> band(nativeIndexed ? 0 : bandPixels);
+			std::vector<std::uint16_t> indexBand(nativeIndexed ? bandPixels : 0);
 
-						if (fits_read_img(fptr, TFLOAT, fpixel, nbuffer, &nullval,
-							buffer, &anynull, &status))
+			//reads count pixels of whole rows from row on into the front of the band
+			auto readBand = [&](std::size_t row, std::size_t count) {
+
+				FITSCONVERTER_PROBE(readProbe, fileName, idx, "read", count, count * std::abs(bitpix) / 8);
+				auto slot = IoGate::enter(options.readGate);
+				if (nativeIndexed)
+					readIndexedRows(fptr, bitpix, scaling, row, std::span(indexBand).first(count));
+				else
+					readImageRows(fptr, row, std::span(band).first(count));
+			};
+
+			ImageStats stats;
+			if (auto range = readDataRange(fptr)) {
+
+				std::tie(stats.min, stats.max) = *range;
+				stats.count = width * height;
+
+			} else if (nativeIndexed) {
+
+				std::vector<std::size_t> histogram(indexed.values.size());
+				for (std::size_t row = 0; row < height; row += bandRows) {
+
+					auto count = std::min(bandRows, height - row) * width;
+					readBand(row, count);
+
+					FITSCONVERTER_PROBE(statsProbe, fileName, idx, "stats", count, count * sizeof(std::uint16_t));
+					for (auto index : std::span(indexBand).first(count))
+						++histogram[index];
+				}
+				stats = histogramStats(indexed.values, histogram);
+
+			} else {
+
+				StatsAccumulator accumulator;
+				for (std::size_t row = 0; row < height; row += bandRows) {
+
+					auto count = std::min(bandRows, height - row) * width;
+					readBand(row, count);
+
+					FITSCONVERTER_PROBE(statsProbe, fileName, idx, "stats", count, count * sizeof(float));
+					accumulator.add(std::span(band).first(count));
+				}
+				stats = accumulator.stats();
+			}
 
-							throw std::exception("fits read");
+			std::size_t taskSize = (options.bandRows ? options.bandRows : std::max<std::size_t>(1, (1 << 16) / width)) * width;
 
-						for (ii = 0; ii < nbuffer; ii++)
-							image.push_back(buffer[ii]);
+			//bmp is written from the bottom (first fits) row up and png from the top down, so each format gets its own sweep of the bands
+			for (auto format : { OutputFormat::BMP, OutputFormat::PNG }) {
 
-						npixels -= nbuffer;
-						fpixel += nbuffer;
+				std::vector<const ColorizePass*> formatPasses;
+				std::vector<OutputSpec> formatOutputs;
+				for (auto& pass : passes)
+					if (pass.format == format) {
+						formatPasses.push_back(&pass);
+						formatOutputs.insert(formatOutputs.end(), pass.outputs.begin(), pass.outputs.end());
 					}
 
-					writeColorizedImages(idx, image, width, height);
+				if (formatPasses.empty()) continue;
+
+				std::vector<BufferPool::Buffer> buffers;
+				std::vector<std::span<uint32_t>> converted;
+				std::vector<std::span<std::uint8_t>> packed;
+				std::vector<PixelFormat> packedFormats;
+
+				std::vector<std::vector<ColorizeVariant>> variants(formatPasses.size());
+				std::vector<std::vector<PackedVariant>> packedVariants(formatPasses.size());
+				std::vector<std::variant<BmpStreamWriter, PngStreamWriter>> writers, packedWriters;
+				writers.reserve(formatOutputs.size());
+				packedWriters.reserve(formatOutputs.size());
+
+				for (std::size_t p = 0; p < formatPasses.size(); ++p)
+					for (auto& output : formatPasses[p]->outputs) {
+
+						auto pixelFormat = options.packedOutputs ? packedFormat(output.colorMode) : PixelFormat::COLOR32;
+						auto& outputWriters = pixelFormat == PixelFormat::COLOR32 ? writers : packedWriters;
+
+						if (pixelFormat == PixelFormat::COLOR32) {
+
+							auto [buffer, rows] = BufferPool::acquire<uint32_t>(bandPixels);
+							buffers.push_back(std::move(buffer));
+							variants[p].push_back({ output.colorMode, double(output.stripes), converted.emplace_back(rows) });
+
+						} else {
+
+							auto [buffer, rows] = BufferPool::acquire<std::uint8_t>(bandRows * pixelFormatRowBytes(pixelFormat, width));
+							buffers.push_back(std::move(buffer));
+							packedVariants[p].push_back({ output.colorMode, double(output.stripes), packed.emplace_back(rows) });
+							packedFormats.push_back(pixelFormat);
+						}
+
+						auto outputName = outputFileName(fileName, idx, output);
+						if (format == OutputFormat::PNG)
+							outputWriters.emplace_back(std::in_place_type<PngStreamWriter>, outputName, width, height, pool, options.pngLevel, pixelFormat, 1 << 20, options.writeGate);
+						else
+							outputWriters.emplace_back(std::in_place_type<BmpStreamWriter>, outputName, width, height, pixelFormat, options.writeGate);
+					}
+
+				//an indexed band colorizes through the color of every value, made once per pass
+				std::vector<std::vector<std::vector<uint32_t>>> luts(formatPasses.size()), packedLuts(formatPasses.size());
+				if (nativeIndexed)
+					for (std::size_t p = 0; p < formatPasses.size(); ++p) {
+
+						auto& pass = *formatPasses[p];
+						FITSCONVERTER_PROBE(lutProbe, fileName, idx, "lut", indexed.values.size() * pass.outputs.size(), 0, outputFileNames(fileName, idx, pass.outputs));
+						visitChannelOrder(format, [&](auto order) {
+							luts[p] = makeColorLuts<decltype(order)::value>(indexed.values, variants[p], stats, pass.viewMin, pass.viewMax);
+							});
+						packedLuts[p] = makePackedLuts(indexed.values, packedVariants[p], stats, pass.viewMin, pass.viewMax);
+					}
+
+				bool topDown = format == OutputFormat::PNG;
+				std::size_t bandCount = (height + bandRows - 1) / bandRows;
+
+				for (std::size_t b = 0; b < bandCount; ++b) {
+
+					auto row = (topDown ? bandCount - 1 - b : b) * bandRows;
+					auto count = std::min(bandRows, height - row) * width;
+					readBand(row, count);
+
+					TaskGroup tasks(pool);
+					{
+						FITSCONVERTER_PROBE(colorizeProbe, fileName, idx, "colorize", count * formatOutputs.size(),
+							outputImageBytes(formatOutputs, width, count / width, options.packedOutputs), outputFileNames(fileName, idx, formatOutputs));
+
+						for (std::size_t offset = 0; offset < count; offset += taskSize)
+							tasks.run([&, offset]() {
+
+								FITSCONVERTER_PROBE_TASK(colorizeProbe);
+
+								auto taskCount = std::min(taskSize, count - offset);
+
+								for (std::size_t p = 0; p < formatPasses.size(); ++p) {
+
+									auto& pass = *formatPasses[p];
+									auto taskVariants = subspanVariants(variants[p], offset, taskCount);
+									auto taskPacked = subspanPackedVariants(packedVariants[p], width, offset / width, taskCount / width);
+
+									if (nativeIndexed) {
+
+										auto taskIndices = std::span<const std::uint16_t>(indexBand).subspan(offset, taskCount);
+										indexSpaceConvert(taskIndices, taskVariants, luts[p]);
+										packIndexConvert(taskIndices, width, taskPacked, packedLuts[p]);
+
+									} else {
+
+										auto taskBand = std::span<const float>(band).subspan(offset, taskCount);
+										visitChannelOrder(format, [&](auto order) {
+											floatSpaceConvert<decltype(order)::value>(taskBand, taskVariants, stats, pass.viewMin, pass.viewMax, options.colorizeLutSize);
+											});
+										packSpaceConvert(taskBand, width, taskPacked, stats, pass.viewMin, pass.viewMax, options.colorizeLutSize);
+									}
+								}
+								});
+						tasks.wait();
+					}
+
+					//the rows handed to the writers; their files are only complete at finish
+					FITSCONVERTER_PROBE(writeProbe, fileName, idx, "write", count * formatOutputs.size(),
+						outputImageBytes(formatOutputs, width, count / width, options.packedOutputs), outputFileNames(fileName, idx, formatOutputs));
+
+					//png writers filter and deflate their strips on the pool, so they are handed the probe to count that cpu too
+					auto appendRows = [&](auto& writer, auto rows) {
+						if constexpr (std::is_same_v<std::remove_cvref_t<decltype(writer)>, PngStreamWriter>)
+							writer.appendRows(rows, FITSCONVERTER_PROBE_POINTER(writeProbe));
+						else
+							writer.appendRows(rows);
+						};
+
+					for (std::size_t i = 0; i < writers.size(); ++i)
+						tasks.run([&, i]() {
+							FITSCONVERTER_PROBE_TASK(writeProbe);
+							std::visit([&](auto& writer) { appendRows(writer, std::span<const uint32_t>(converted[i]).first(count)); }, writers[i]);
+							});
+					for (std::size_t i = 0; i < packedWriters.size(); ++i)
+						tasks.run([&, i]() {
+							FITSCONVERTER_PROBE_TASK(writeProbe);
+							auto bytes = count / width * pixelFormatRowBytes(packedFormats[i], width);
+							std::visit([&](auto& writer) { appendRows(writer, std::span<const std::uint8_t>(packed[i]).first(bytes)); }, packedWriters[i]);
+							});
+					tasks.wait();
+				}
+
+				FITSCONVERTER_PROBE(finishProbe, fileName, idx, "write", 0, 0, outputFileNames(fileName, idx, formatOutputs));
+
+				for (auto& writer : writers)
+					std::visit([](auto& writer) { writer.finish(); }, writer);
+				for (auto& writer : packedWriters)
+					std::visit([](auto& writer) { writer.finish(); }, writer);
+			}
+
+			++convertedHdus;
+			convertedPixels += width * height;
+			FITSCONVERTER_PROFILE_HDU(width * height);
+		};
+
+		//reads the HDU whole when the image and the two passes of outputs writeColorizedImages keeps alive fit the budget,
+		//and streams it otherwise
+		auto convertHdu = [&](fitsfile* fptr, std::size_t idx, int bitpix, std::size_t width, std::size_t height, std::size_t budget) {
+
+			auto wholeBytes = width * height * (sizeof(float) + 2 * passOutputs * sizeof(std::uint32_t));
+
+			if (budget != 0 && wholeBytes > budget)
+				streamHdu(fptr, idx, bitpix, width, height, budget);
+			else {
+				auto hdu = readHdu(fptr, idx, bitpix, width, height);
+				colorizeHdu(hdu);
+			}
+			return true;
+		};
+
+		std::vector<std::size_t> requestedHdus = job.hdus;
+		std::ranges::sort(requestedHdus);
+		requestedHdus.erase(std::unique(requestedHdus.begin(), requestedHdus.end()), requestedHdus.end());
+
+		//calls hduFunction(fptr, idx, bitpix, width, height) for every image HDU of the job in order, until it returns false;
+		//idx counts every HDU, so it is the cfitsio HDU number less one. the scan stops at the last requested HDU
+		auto forEachHdu = [&](fitsfile* fptr, auto&& hduFunction) {
+
+			int status = 0, hdutype = IMAGE_HDU, bitpix = 0, naxis = 0;
+			LONGLONG naxes[10] = {};
+
+			std::size_t idx = 0, found = 0;
+			do {
+
+				//tables are skipped like empty images; a failure on an image HDU would leave status set and stall the scan
+				naxis = 0;
+				if (fits_get_hdu_type(fptr, &hdutype, &status) == 0 && hdutype == IMAGE_HDU)
+					fits_get_img_paramll(fptr, 10, &bitpix, &naxis, naxes, &status);
+
+				if (status)
+					throw std::runtime_error(std::format("failed to read the header of hdu {}", idx));
+
+				if (naxis != 0 && (requestedHdus.empty() || std::ranges::binary_search(requestedHdus, idx))) {
 
+					if (!hduFunction(fptr, idx, bitpix, std::size_t(naxes[0]), std::size_t(naxes[1])))
+						return;
+
+					if (++found == requestedHdus.size())
+						return;
 				}
-				fits_movrel_hdu(fptr, 1, NULL, &status);
+
+				if (fits_movrel_hdu(fptr, 1, NULL, &status) && status != END_OF_FILE)
+					throw std::runtime_error(std::format("failed to move past hdu {}", idx));
 
 				++idx;
 			} while (status != END_OF_FILE);
 
-			status = 0;
+			if (!requestedHdus.empty())
+				throw std::runtime_error("requested hdu is not an image");
+		};
+
+		auto readFitsImages = [&]() {
+
+			auto fits = openFits();
+			auto fptr = fits.get();
+
+			if (options.prefetchDepth == 0 || options.memoryBudget != 0)
+				forEachHdu(fptr, [&](fitsfile* fptr, std::size_t idx, int bitpix, std::size_t width, std::size_t height) {
+					return convertHdu(fptr, idx, bitpix, width, height, options.memoryBudget);
+					});
+			else {
+
+				//cfitsio reads on its own thread, the pool colorizes; only the reader touches fptr
+				BoundedQueue<HduImage> decoded(options.prefetchDepth);
+				std::exception_ptr readError;
+
+				std::thread reader([&]() {
+
+					try {
+						//waiting for a free slot before reading bounds the HDUs in memory, not just those queued
+						if (decoded.waitForSpace())
+							forEachHdu(fptr, [&](fitsfile* fptr, std::size_t idx, int bitpix, std::size_t width, std::size_t height) {
+								return decoded.push(readHdu(fptr, idx, bitpix, width, height)) && decoded.waitForSpace();
+								});
+					}
+					catch (...) {
+						readError = std::current_exception();
+					}
+					decoded.close();
+					});
+
+				try {
+					while (auto hdu = decoded.pop())
+						colorizeHdu(*hdu);
+				}
+				catch (...) {
+					decoded.close();
+					reader.join();
+					throw;
+				}
+				reader.join();
 
-			if (fits_close_file(fptr, &status))
-				throw std::exception("fits close");
+				if (readError) std::rethrow_exception(readError);
+			}
+		};
+
+		//converts disjoint HDUs on several threads; cfitsio handles cannot be shared between threads,
+		//so each opens its own, which needs cfitsio built reentrant
+		auto readFitsImagesParallel = [&](std::size_t threadCount) {
+
+			std::vector<std::size_t> imageHdus;
+
+			forEachHdu(openFits().get(), [&](fitsfile*, std::size_t idx, int, std::size_t, std::size_t) {
+				imageHdus.push_back(idx);
+				return true;
+				});
+
+			if (imageHdus.empty()) return;
+
+			threadCount = std::min(threadCount, imageHdus.size());
+
+			auto budget = options.memoryBudget ? std::max<std::size_t>(options.memoryBudget / threadCount, 1) : 0;
+
+			std::atomic<std::size_t> next = 0;
+			std::mutex errorMutex;
+			std::exception_ptr error;
+
+			auto convertHdus = [&]() {
+
+				try {
+					auto fits = openFits();
+					auto fptr = fits.get();
+
+					for (std::size_t i; (i = next++) < imageHdus.size(); ) {
+
+						int status = 0, bitpix, naxis;
+						LONGLONG naxes[10];
+
+						fits_movabs_hdu(fptr, int(imageHdus[i] + 1), NULL, &status);
+						fits_get_img_paramll(fptr, 10, &bitpix, &naxis, naxes, &status);
+
+						if (status)
+							throw std::runtime_error("failed to read hdu");
+
+						convertHdu(fptr, imageHdus[i], bitpix, naxes[0], naxes[1], budget);
+					}
+				}
+				catch (...) {
+
+					//the first failure stops the other threads from taking more HDUs
+					std::scoped_lock lock(errorMutex);
+					if (!error) error = std::current_exception();
+					next = imageHdus.size();
+				}
+			};
+
+			std::vector<std::thread> threads;
+			for (std::size_t i = 1; i < threadCount; ++i)
+				threads.emplace_back(convertHdus);
+
+			convertHdus();
+
+			for (auto& thread : threads)
+				thread.join();
+
+			if (error) std::rethrow_exception(error);
 		};
 
-		readFitsImages();
+		auto hduThreads = options.hduThreads ? options.hduThreads : std::thread::hardware_concurrency();
+
+		if (hduThreads > 1)
+			readFitsImagesParallel(hduThreads);
+		else
+			readFitsImages();
+
+		return { convertedHdus, convertedPixels, convertedHdus * outputCount };
+	}
+
+	//every default output of every image HDU, in options.outputFormat
+	void readFITSimagesAndColorize(const std::string& fileName, const ConvertOptions& options = {}) {
 
+		runConversionJob({ fileName, defaultOutputs(options.outputFormat), {}, options });
 	}
 };
 
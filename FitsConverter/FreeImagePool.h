@@ -0,0 +1,182 @@
+#pragma once
+
+//windows.h must come before FreeImage.h, which otherwise declares its own copies of the bitmap structs
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#endif
+
+#ifndef FREEIMAGE_LIB
+	#define FREEIMAGE_LIB
+#endif
+#include <FreeImage.h>
+
+#include <mutex>
+#include <deque>
+#include <span>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace FitsConverter {
+
+	//FreeImage_Initialise for the life of the process, on the first use of freeimage
+	void initFreeImage() {
+
+		static struct FreeImageLibrary {
+
+			FreeImageLibrary() { FreeImage_Initialise(); }
+			~FreeImageLibrary() { FreeImage_DeInitialise(); }
+		} library;
+	}
+
+	//32 bit FIBITMAPs kept for reuse by dimensions. the colorizers write straight into FreeImage_GetBits,
+	//whose rows are the bottom up, four byte aligned rows of bmpChannelOrder pixels they produce anyway
+	class BitmapPool {
+	public:
+
+		//owns one bitmap and hands it back to its pool when destroyed
+		class Bitmap {
+		public:
+
+			Bitmap() = default;
+
+			Bitmap(Bitmap&& other) noexcept : pool(std::exchange(other.pool, nullptr)), bitmap(std::exchange(other.bitmap, nullptr)) {}
+
+			Bitmap& operator=(Bitmap&& other) noexcept {
+
+				if (this != &other) {
+
+					reset();
+					pool = std::exchange(other.pool, nullptr);
+					bitmap = std::exchange(other.bitmap, nullptr);
+				}
+				return *this;
+			}
+
+			~Bitmap() { reset(); }
+
+			FIBITMAP* get() const { return bitmap; }
+
+			std::span<std::uint32_t> pixels() const {
+
+				return { reinterpret_cast<std::uint32_t*>(FreeImage_GetBits(bitmap)), std::size_t(FreeImage_GetWidth(bitmap)) * FreeImage_GetHeight(bitmap) };
+			}
+
+			void reset() {
+
+				if (pool) pool->release(bitmap);
+				pool = nullptr;
+				bitmap = nullptr;
+			}
+
+		private:
+
+			friend class BitmapPool;
+
+			BitmapPool* pool = nullptr;
+			FIBITMAP* bitmap = nullptr;
+		};
+
+		BitmapPool() { initFreeImage(); }
+
+		~BitmapPool() { trim(); }
+
+		BitmapPool(const BitmapPool&) = delete;
+		BitmapPool& operator=(const BitmapPool&) = delete;
+
+		//a width x height bitmap, pixels uninitialized
+		Bitmap acquire(std::size_t width, std::size_t height) {
+
+			initFreeImage();
+
+			Bitmap bitmap;
+			bitmap.pool = this;
+
+			{
+				std::scoped_lock lock(mutex);
+				for (auto it = unused.begin(); it != unused.end(); ++it)
+					if (FreeImage_GetWidth(*it) == width && FreeImage_GetHeight(*it) == height) {
+
+						bitmap.bitmap = *it;
+						unusedBytes -= bitmapBytes(*it);
+						unused.erase(it);
+						break;
+					}
+			}
+
+			if (!bitmap.bitmap) {
+
+				bitmap.bitmap = FreeImage_Allocate(int(width), int(height), 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+				if (!bitmap.bitmap) {
+
+					bitmap.pool = nullptr;
+					throw std::runtime_error("failed to allocate bitmap");
+				}
+			}
+			return bitmap;
+		}
+
+		void trim() {
+
+			std::scoped_lock lock(mutex);
+			for (auto bitmap : unused)
+				FreeImage_Unload(bitmap);
+			unused.clear();
+			unusedBytes = 0;
+		}
+
+		//lowers maxUnusedBytes to bytes when it is above, unloading what no longer fits; a cap never rises again
+		void limitUnusedBytes(std::size_t bytes) {
+
+			std::scoped_lock lock(mutex);
+			maxUnusedBytes = std::min(maxUnusedBytes, bytes);
+			unloadPastLimits();
+		}
+
+		//bitmaps kept unused, and the pixel bytes they may hold together; past either the longest unused are unloaded
+		std::size_t maxUnused = 32;
+		std::size_t maxUnusedBytes = std::size_t(1) << 30;
+
+	private:
+
+		static std::size_t bitmapBytes(FIBITMAP* bitmap) {
+
+			return std::size_t(FreeImage_GetPitch(bitmap)) * FreeImage_GetHeight(bitmap);
+		}
+
+		void release(FIBITMAP* bitmap) {
+
+			std::scoped_lock lock(mutex);
+			unused.push_back(bitmap);
+			unusedBytes += bitmapBytes(bitmap);
+
+			unloadPastLimits();
+		}
+
+		//called with the mutex held
+		void unloadPastLimits() {
+
+			while (!unused.empty() && (unused.size() > maxUnused || unusedBytes > maxUnusedBytes)) {
+
+				unusedBytes -= bitmapBytes(unused.front());
+				FreeImage_Unload(unused.front());
+				unused.pop_front();
+			}
+		}
+
+		std::mutex mutex;
+		std::deque<FIBITMAP*> unused;
+		std::size_t unusedBytes = 0;
+	};
+
+	//shared by every conversion
+	BitmapPool& bitmapPool() {
+
+		static BitmapPool pool;
+		return pool;
+	}
+};
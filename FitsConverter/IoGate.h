@@ -0,0 +1,80 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <utility>
+
+
+namespace FitsConverter {
+
+	//caps how many threads do one kind of file io at once. a slot is held around the io itself and never while waiting on pool tasks,
+	//so every holder finishes and a pool worker blocked on a slot cannot stall the tasks it would wait for
+	class IoGate {
+	public:
+
+		explicit IoGate(std::size_t slots) : available(std::max<std::size_t>(slots, 1)) {}
+
+		IoGate(const IoGate&) = delete;
+		IoGate& operator=(const IoGate&) = delete;
+
+		//one slot, given back when destroyed
+		class Slot {
+		public:
+
+			Slot() = default;
+			explicit Slot(IoGate* gate) : gate(gate) {}
+
+			Slot(Slot&& other) noexcept : gate(std::exchange(other.gate, nullptr)) {}
+			Slot& operator=(Slot&& other) noexcept {
+
+				if (this != &other) {
+					release();
+					gate = std::exchange(other.gate, nullptr);
+				}
+				return *this;
+			}
+
+			~Slot() { release(); }
+
+			void release() {
+
+				if (gate) std::exchange(gate, nullptr)->leave();
+			}
+
+		private:
+
+			IoGate* gate = nullptr;
+		};
+
+		//blocks until a slot is free
+		Slot enter() {
+
+			std::unique_lock lock(mutex);
+			freed.wait(lock, [&]() { return available > 0; });
+			--available;
+			return Slot(this);
+		}
+
+		//a slot of gate, or no limit when there is no gate
+		static Slot enter(IoGate* gate) {
+
+			return gate ? gate->enter() : Slot();
+		}
+
+	private:
+
+		void leave() {
+
+			{
+				std::scoped_lock lock(mutex);
+				++available;
+			}
+			freed.notify_one();
+		}
+
+		std::mutex mutex;
+		std::condition_variable freed;
+		std::size_t available;
+	};
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+//windows.h must come before FreeImage.h, which otherwise declares its own copies of the bitmap structs
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#include <string>
+#include <span>
+#include <cstddef>
+#include <stdexcept>
+
+
+namespace FitsConverter {
+
+	//read only view of a whole file, served from the page cache
+	class MappedFile {
+	public:
+
+		explicit MappedFile(const std::string& fileName) {
+
+#if defined(_WIN32)
+			file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+				throw std::runtime_error("failed to open file for mapping");
+
+			LARGE_INTEGER fileSize;
+			GetFileSizeEx(file, &fileSize);
+			size = fileSize.QuadPart;
+
+			if (size > 0) {
+
+				mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (mapping) view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+				if (!view) {
+					close();
+					throw std::runtime_error("failed to map file");
+				}
+			}
+#else
+			file = ::open(fileName.c_str(), O_RDONLY);
+			if (file < 0)
+				throw std::runtime_error("failed to open file for mapping");
+
+			struct stat fileStat;
+			fstat(file, &fileStat);
+			size = fileStat.st_size;
+
+			if (size > 0) {
+
+				view = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+				if (view == MAP_FAILED) {
+					view = nullptr;
+					close();
+					throw std::runtime_error("failed to map file");
+				}
+				::madvise(view, size, MADV_SEQUENTIAL);
+			}
+#endif
+		}
+
+		~MappedFile() { close(); }
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		std::span<const std::byte> bytes() const {
+			return { static_cast<const std::byte*>(view), size };
+		}
+
+	private:
+
+		void close() {
+
+#if defined(_WIN32)
+			if (view) UnmapViewOfFile(view);
+			if (mapping) CloseHandle(mapping);
+			if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+			mapping = nullptr;
+			file = INVALID_HANDLE_VALUE;
+#else
+			if (view) ::munmap(view, size);
+			if (file >= 0) ::close(file);
+			file = -1;
+#endif
+			view = nullptr;
+		}
+
+#if defined(_WIN32)
+		HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+#else
+		int file = -1;
+#endif
+		void* view = nullptr;
+		std::size_t size = 0;
+	};
+};
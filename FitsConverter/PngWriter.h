@@ -0,0 +1,255 @@
+#pragma once
+
+#include "Colorize.h"
+#include "ThreadPool.h"
+#include "IoGate.h"
+#include "Profiler.h"
+
+#include <zlib.h>
+
+#include <fstream>
+#include <string>
+#include <span>
+#include <vector>
+#include <array>
+#include <optional>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace FitsConverter {
+
+	//8 bit rgba with alpha, colorized straight into png byte order
+	constexpr ChannelOrder pngChannelOrder = ChannelOrder::RGBA;
+
+	//writes a png a band of rows at a time, deflating strips of each band in parallel, pigz style:
+	//every strip is its own raw deflate stream ended by a sync flush, primed with the 32K of filtered data before it,
+	//and stored as its own IDAT chunk; the adler32 of the whole stream is combined from the strips in order.
+	//png rows run top down while fits (and bmp) rows run bottom up, so each band is given in fits row order
+	//and written flipped, and bands are appended from the top of the image down.
+	//file writes hold a slot of writeGate, deflating does not
+	class PngStreamWriter {
+	public:
+
+		PngStreamWriter(const std::string& fileName, std::size_t width, std::size_t height, ThreadPool& pool, int level = Z_DEFAULT_COMPRESSION, PixelFormat format = PixelFormat::COLOR32, std::size_t stripBytes = 1 << 20, IoGate* writeGate = nullptr)
+			: height(height), rowBytes(pixelFormatRowBytes(format, width)), pixelBytes(format == PixelFormat::COLOR32 ? 4 : 1)
+			, pool(pool), level(level), stripBytes(stripBytes), writeGate(writeGate) {
+
+			auto slot = IoGate::enter(writeGate);
+
+			file.open(fileName, std::ios::binary);
+			if (!file)
+				throw std::runtime_error("failed to create png");
+
+			static constexpr std::uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+			std::vector<std::uint8_t> header(13);
+			putBigEndian(header.data(), std::uint32_t(width));
+			putBigEndian(header.data() + 4, std::uint32_t(height));
+			header[8] = format == PixelFormat::BIT1 ? 1 : 8;		//bit depth
+			header[9] = format == PixelFormat::COLOR32 ? 6 : 0;		//truecolor with alpha, or greyscale
+			writeChunk("IHDR", header);
+		}
+
+		//pngChannelOrder pixels of whole rows, in fits order
+		void appendRows(std::span<const std::uint32_t> pixels, StageProbe* probe = nullptr) {
+
+			appendRows({ reinterpret_cast<const std::uint8_t*>(pixels.data()), pixels.size_bytes() }, probe);
+		}
+
+		//whole rows in the writer's pixel format, in fits order. the strips are filtered and deflated on the pool,
+		//their cpu counted by probe when there is one
+		void appendRows(std::span<const std::uint8_t> pixels, StageProbe* probe = nullptr) {
+
+			std::size_t rows = pixels.size() / rowBytes;
+			std::size_t stripRows = std::max<std::size_t>(1, stripBytes / filteredRowBytes());
+
+			struct Strip {
+
+				std::vector<std::uint8_t> chunk;
+				uLong adler = 0;
+				std::size_t filteredSize = 0;
+			};
+			std::vector<Strip> strips((rows + stripRows - 1) / stripRows);
+
+			TaskGroup tasks(pool);
+			for (std::size_t s = 0; s < strips.size(); ++s)
+				tasks.run([&, s]() {
+
+					std::optional<StageProbe::Task> probeTask;
+					if (probe) probeTask.emplace(*probe);
+
+					auto firstRow = s * stripRows, stripRowCount = std::min(stripRows, rows - firstRow);
+					bool streamStart = rowsWritten == 0 && s == 0, streamEnd = rowsWritten + firstRow + stripRowCount == height;
+
+					std::vector<std::uint8_t> filtered;
+					filterRows(pixels, firstRow, stripRowCount, filtered);
+
+					std::vector<std::uint8_t> dictionary;
+					if (s == 0)
+						dictionary = window;
+					else
+						windowBefore(pixels, firstRow, dictionary);
+
+					strips[s].adler = adler32(1, filtered.data(), uInt(filtered.size()));
+					strips[s].filteredSize = filtered.size();
+					strips[s].chunk = deflateChunk(filtered, dictionary, streamStart, streamEnd);
+					});
+			tasks.wait();
+
+			auto slot = IoGate::enter(writeGate);
+
+			for (auto& strip : strips) {
+
+				adler = adler32_combine(adler, strip.adler, z_off_t(strip.filteredSize));
+				file.write(reinterpret_cast<const char*>(strip.chunk.data()), strip.chunk.size());
+			}
+
+			windowBefore(pixels, rows, window);
+			rowsWritten += rows;
+
+			if (!file)
+				throw std::runtime_error("png write");
+		}
+
+		//closes the zlib stream with its adler32 and ends the png; every row must have been appended
+		void finish() {
+
+			if (rowsWritten != height)
+				throw std::runtime_error("png is missing rows");
+
+			std::vector<std::uint8_t> trailer(4);
+			putBigEndian(trailer.data(), std::uint32_t(adler));
+
+			auto slot = IoGate::enter(writeGate);
+			writeChunk("IDAT", trailer);
+			writeChunk("IEND", {});
+
+			file.close();
+			if (!file)
+				throw std::runtime_error("png write");
+		}
+
+	private:
+
+		static constexpr std::size_t windowSize = 32768;
+
+		static void putBigEndian(std::uint8_t* bytes, std::uint32_t value) {
+
+			for (std::size_t b = 0; b < 4; ++b)
+				bytes[b] = std::uint8_t(value >> (24 - 8 * b));
+		}
+
+		std::size_t filteredRowBytes() const { return rowBytes + 1; }
+
+		//filters png rows firstRow .. firstRow + rowCount of the band, counted from its top, which is the last fits row.
+		//every row gets the Sub filter, which only looks within the row, so strips filter independently
+		void filterRows(std::span<const std::uint8_t> pixels, std::size_t firstRow, std::size_t rowCount, std::vector<std::uint8_t>& filtered) const {
+
+			filtered.resize(rowCount * filteredRowBytes());
+
+			auto target = filtered.data();
+
+			for (std::size_t row = firstRow; row < firstRow + rowCount; ++row, target += rowBytes + 1) {
+
+				auto source = pixels.data() + (pixels.size() / rowBytes - 1 - row) * rowBytes;
+
+				target[0] = 1;
+				std::copy_n(source, std::min(pixelBytes, rowBytes), target + 1);
+				for (std::size_t i = pixelBytes; i < rowBytes; ++i)
+					target[1 + i] = std::uint8_t(source[i] - source[i - pixelBytes]);
+			}
+		}
+
+		//the last (up to) 32K of filtered data preceding png row of the band, taken from the rows above it
+		void windowBefore(std::span<const std::uint8_t> pixels, std::size_t row, std::vector<std::uint8_t>& dictionary) const {
+
+			auto windowRows = std::min(row, (windowSize + filteredRowBytes() - 1) / filteredRowBytes());
+			if (windowRows == 0) return;
+
+			filterRows(pixels, row - windowRows, windowRows, dictionary);
+
+			if (dictionary.size() > windowSize)
+				dictionary.erase(dictionary.begin(), dictionary.end() - windowSize);
+		}
+
+		//one IDAT chunk holding a strip deflated on its own; the first also carries the zlib header
+		std::vector<std::uint8_t> deflateChunk(std::span<const std::uint8_t> filtered, std::span<const std::uint8_t> dictionary, bool streamStart, bool streamEnd) const {
+
+			z_stream stream{};
+			if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+				throw std::runtime_error("deflate init");
+
+			if (!dictionary.empty())
+				deflateSetDictionary(&stream, dictionary.data(), uInt(dictionary.size()));
+
+			//length, type, zlib header, then room for the compressed strip and its flush marker
+			std::size_t headerBytes = 8 + (streamStart ? 2 : 0);
+			std::vector<std::uint8_t> chunk(headerBytes + deflateBound(&stream, uLong(filtered.size())) + 16);
+
+			if (streamStart) {
+
+				//CMF 0x78 is deflate with a 32K window, FLG carries the level hint and the check bits
+				chunk[8] = 0x78;
+				chunk[9] = level == 0 || level == 1 ? 0x01 : level >= 2 && level <= 5 ? 0x5E : level >= 7 ? 0xDA : 0x9C;
+			}
+
+			stream.next_in = const_cast<Bytef*>(filtered.data());
+			stream.avail_in = uInt(filtered.size());
+			stream.next_out = chunk.data() + headerBytes;
+			stream.avail_out = uInt(chunk.size() - headerBytes);
+
+			//a sync flush ends the strip on a byte boundary without marking the last block, so strips concatenate
+			auto result = deflate(&stream, streamEnd ? Z_FINISH : Z_SYNC_FLUSH);
+			std::size_t dataBytes = headerBytes - 8 + stream.total_out;
+			deflateEnd(&stream);
+
+			if (result != (streamEnd ? Z_STREAM_END : Z_OK) || stream.avail_in != 0)
+				throw std::runtime_error("deflate");
+
+			chunk.resize(8 + dataBytes + 4);
+			putBigEndian(chunk.data(), std::uint32_t(dataBytes));
+			std::copy_n("IDAT", 4, chunk.begin() + 4);
+			putBigEndian(chunk.data() + 8 + dataBytes, std::uint32_t(crc32(0, chunk.data() + 4, uInt(4 + dataBytes))));
+
+			return chunk;
+		}
+
+		void writeChunk(const char* type, const std::vector<std::uint8_t>& data) {
+
+			std::vector<std::uint8_t> chunk(8 + data.size() + 4);
+			putBigEndian(chunk.data(), std::uint32_t(data.size()));
+			std::copy_n(type, 4, chunk.begin() + 4);
+			std::copy(data.begin(), data.end(), chunk.begin() + 8);
+			putBigEndian(chunk.data() + 8 + data.size(), std::uint32_t(crc32(0, chunk.data() + 4, uInt(4 + data.size()))));
+
+			file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+		}
+
+		std::ofstream file;
+		std::size_t height, rowBytes, pixelBytes;
+		ThreadPool& pool;
+		int level;
+		std::size_t stripBytes;
+		IoGate* writeGate;
+
+		std::size_t rowsWritten = 0;
+		uLong adler = adler32(0, nullptr, 0);
+		std::vector<std::uint8_t> window;
+	};
+
+	//writes a whole png, its strips deflated in parallel on pool
+	void writePngFile(const std::string& fileName, std::size_t width, std::size_t height, std::span<const std::uint8_t> rows, PixelFormat format, ThreadPool& pool, int level = Z_DEFAULT_COMPRESSION, IoGate* writeGate = nullptr, StageProbe* probe = nullptr) {
+
+		PngStreamWriter writer(fileName, width, height, pool, level, format, 1 << 20, writeGate);
+		writer.appendRows(rows, probe);
+		writer.finish();
+	}
+
+	void writePngFile(const std::string& fileName, std::size_t width, std::size_t height, std::span<const std::uint32_t> pixels, ThreadPool& pool, int level = Z_DEFAULT_COMPRESSION, IoGate* writeGate = nullptr, StageProbe* probe = nullptr) {
+
+		writePngFile(fileName, width, height, { reinterpret_cast<const std::uint8_t*>(pixels.data()), pixels.size_bytes() }, PixelFormat::COLOR32, pool, level, writeGate, probe);
+	}
+};
@@ -0,0 +1,306 @@
+#pragma once
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <time.h>
+#endif
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <ostream>
+#include <format>
+#include <utility>
+
+
+//stage probes of the conversion engine, compiled in only when FITSCONVERTER_PROFILE is defined; without it they expand to nothing
+//and their arguments are never evaluated. a profiled build writes a json report of every probe to Profiler::reportPath at exit.
+//read and write probes include any wait on the io gates of a batch
+#if defined(FITSCONVERTER_PROFILE)
+	#define FITSCONVERTER_PROBE(probe, ...) ::FitsConverter::StageProbe probe(__VA_ARGS__)
+	#define FITSCONVERTER_PROBE_TASK(probe) ::FitsConverter::StageProbe::Task probe##Task(probe)
+	#define FITSCONVERTER_PROBE_BYTES(probe, bytes) probe.addBytes(bytes)
+	#define FITSCONVERTER_PROBE_POINTER(probe) (&probe)
+	#define FITSCONVERTER_PROFILE_HDU(pixels) ::FitsConverter::Profiler::instance().countHdu(pixels)
+#else
+	#define FITSCONVERTER_PROBE(probe, ...)
+	#define FITSCONVERTER_PROBE_TASK(probe)
+	#define FITSCONVERTER_PROBE_BYTES(probe, bytes)
+	#define FITSCONVERTER_PROBE_POINTER(probe) nullptr
+	#define FITSCONVERTER_PROFILE_HDU(pixels)
+#endif
+
+
+namespace FitsConverter {
+
+#if defined(FITSCONVERTER_PROFILE)
+	constexpr bool profilingEnabled = true;
+#else
+	constexpr bool profilingEnabled = false;
+#endif
+
+#if defined(_WIN32)
+	double fileTimeSeconds(const FILETIME& time) {
+
+		return (std::uint64_t(time.dwHighDateTime) << 32 | time.dwLowDateTime) / 1e7;
+	}
+#endif
+
+	//cpu seconds used by the calling thread
+	double threadCpuSeconds() {
+
+#if defined(_WIN32)
+		FILETIME creation, exit, kernel, user;
+		GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+		return fileTimeSeconds(kernel) + fileTimeSeconds(user);
+#else
+		timespec time;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+		return time.tv_sec + time.tv_nsec / 1e9;
+#endif
+	}
+
+	//cpu seconds used by every thread of the process
+	double processCpuSeconds() {
+
+#if defined(_WIN32)
+		FILETIME creation, exit, kernel, user;
+		GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+		return fileTimeSeconds(kernel) + fileTimeSeconds(user);
+#else
+		timespec time;
+		clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+		return time.tv_sec + time.tv_nsec / 1e9;
+#endif
+	}
+
+	//one stage of one HDU, summed over every probe of it. pixels are those the stage produces: fits pixels for read and stats,
+	//output pixels for colorize and write. bytes are those it reads or writes
+	struct StageTotals {
+
+		std::string fileName;
+		std::size_t hdu = 0;
+		std::string stage;
+		std::vector<std::string> outputs;
+
+		std::size_t probes = 0, pixels = 0, bytes = 0;
+		double wallSeconds = 0.0, cpuSeconds = 0.0;
+
+		double megaPixelsPerSecond() const { return wallSeconds > 0.0 ? pixels / 1e6 / wallSeconds : 0.0; }
+		double megaBytesPerSecond() const { return wallSeconds > 0.0 ? bytes / 1e6 / wallSeconds : 0.0; }
+
+		void add(const StageTotals& other) {
+
+			probes += other.probes;
+			pixels += other.pixels;
+			bytes += other.bytes;
+			wallSeconds += other.wallSeconds;
+			cpuSeconds += other.cpuSeconds;
+		}
+	};
+
+	//collects the stage probes of the whole process, from its first probe on
+	class Profiler {
+	public:
+
+		static Profiler& instance() {
+
+			static Profiler profiler;
+			return profiler;
+		}
+
+		Profiler(const Profiler&) = delete;
+		Profiler& operator=(const Profiler&) = delete;
+
+		~Profiler() {
+
+			if (reportPath.empty() || stages.empty()) return;
+
+			std::ofstream report(reportPath);
+			writeReport(report);
+		}
+
+		//adds a probe to the totals of its file, HDU, stage and outputs
+		void record(StageTotals probe) {
+
+			std::string key = std::format("{}\n{}\n{}", probe.fileName, probe.hdu, probe.stage);
+			for (auto& output : probe.outputs)
+				key += "\n" + output;
+
+			std::scoped_lock lock(mutex);
+
+			auto [it, added] = index.try_emplace(std::move(key), stages.size());
+			if (added)
+				stages.push_back(std::move(probe));
+			else
+				stages[it->second].add(probe);
+		}
+
+		void countHdu(std::size_t pixels) {
+
+			std::scoped_lock lock(mutex);
+			++hdus;
+			hduPixels += pixels;
+		}
+
+		//the run as a whole, every stage summed over its HDUs, and every stage of every HDU.
+		//stage wall times overlap when HDUs, files or passes run at once, so only the run's wall time is elapsed time
+		void writeReport(std::ostream& out) const {
+
+			std::scoped_lock lock(mutex);
+
+			double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			out << "{\n";
+			out << std::format("  \"run\": {{ \"wallSeconds\": {}, \"cpuSeconds\": {}, \"hdus\": {}, \"pixels\": {}, \"megaPixelsPerSecond\": {} }},\n",
+				wallSeconds, processCpuSeconds() - startCpu, hdus, hduPixels, wallSeconds > 0.0 ? hduPixels / 1e6 / wallSeconds : 0.0);
+
+			std::vector<StageTotals> stageTotals;
+			for (auto& stage : stages) {
+
+				auto totals = std::ranges::find(stageTotals, stage.stage, &StageTotals::stage);
+				if (totals == stageTotals.end()) {
+					totals = stageTotals.emplace(stageTotals.end());
+					totals->stage = stage.stage;
+				}
+				totals->add(stage);
+			}
+
+			out << "  \"stageTotals\": [\n";
+			for (std::size_t i = 0; i < stageTotals.size(); ++i)
+				out << "    { " << jsonFields(stageTotals[i]) << (i + 1 < stageTotals.size() ? " },\n" : " }\n");
+			out << "  ],\n";
+
+			out << "  \"stages\": [\n";
+			for (std::size_t i = 0; i < stages.size(); ++i) {
+
+				auto& stage = stages[i];
+
+				out << std::format("    {{ \"file\": {}, \"hdu\": {}, \"outputs\": [", jsonString(stage.fileName), stage.hdu);
+				for (std::size_t o = 0; o < stage.outputs.size(); ++o)
+					out << (o ? ", " : "") << jsonString(stage.outputs[o]);
+				out << "], " << jsonFields(stage) << (i + 1 < stages.size() ? " },\n" : " }\n");
+			}
+			out << "  ]\n}\n";
+		}
+
+		//where the report is written at exit; empty writes none. set it before the first conversion
+		std::string reportPath = "fitsconverter_profile.json";
+
+	private:
+
+		Profiler() = default;
+
+		static std::string jsonString(std::string_view text) {
+
+			std::string quoted = "\"";
+			for (char c : text) {
+
+				if (c == '"' || c == '\\') quoted += '\\';
+
+				if (static_cast<unsigned char>(c) < 0x20)
+					quoted += std::format("\\u{:04x}", int(c));
+				else
+					quoted += c;
+			}
+			return quoted + "\"";
+		}
+
+		static std::string jsonFields(const StageTotals& stage) {
+
+			return std::format("\"stage\": {}, \"probes\": {}, \"wallSeconds\": {}, \"cpuSeconds\": {}, \"pixels\": {}, \"bytes\": {}, \"megaPixelsPerSecond\": {}, \"megaBytesPerSecond\": {}",
+				jsonString(stage.stage), stage.probes, stage.wallSeconds, stage.cpuSeconds, stage.pixels, stage.bytes, stage.megaPixelsPerSecond(), stage.megaBytesPerSecond());
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		double startCpu = processCpuSeconds();
+
+		mutable std::mutex mutex;
+		std::vector<StageTotals> stages;
+		std::map<std::string, std::size_t> index;
+		std::size_t hdus = 0, hduPixels = 0;
+	};
+
+	//times the scope it lives in as one probe of a stage. its cpu time is that of its own thread,
+	//unless pool tasks did the work of the stage and counted their cpu through Task
+	class StageProbe {
+	public:
+
+		StageProbe(const std::string& fileName, std::size_t hdu, std::string_view stage, std::size_t pixels = 0, std::size_t bytes = 0, std::vector<std::string> outputs = {})
+			: startCpu(threadCpuSeconds()) {
+
+			totals.fileName = fileName;
+			totals.hdu = hdu;
+			totals.stage = stage;
+			totals.outputs = std::move(outputs);
+			totals.probes = 1;
+			totals.pixels = pixels;
+			totals.bytes = bytes;
+		}
+
+		StageProbe(const StageProbe&) = delete;
+		StageProbe& operator=(const StageProbe&) = delete;
+
+		~StageProbe() {
+
+			totals.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			totals.cpuSeconds = tasks ? taskCpuSeconds.load() : threadCpuSeconds() - startCpu;
+
+			Profiler::instance().record(std::move(totals));
+		}
+
+		void addBytes(std::size_t bytes) { totals.bytes += bytes; }
+
+		//counts the cpu of one pool task of the stage; it must end before the probe does.
+		//a task of the probe run by a thread already counting it, while it helps in a wait, is not counted twice
+		class Task {
+		public:
+
+			explicit Task(StageProbe& probe) : probe(probe), outer(counting()), startCpu(threadCpuSeconds()) {
+
+				probe.tasks = true;
+				counting() = &probe;
+			}
+
+			Task(const Task&) = delete;
+			Task& operator=(const Task&) = delete;
+
+			~Task() {
+
+				counting() = outer;
+				if (outer != &probe) probe.taskCpuSeconds += threadCpuSeconds() - startCpu;
+			}
+
+		private:
+
+			static StageProbe*& counting() {
+
+				thread_local StageProbe* probe = nullptr;
+				return probe;
+			}
+
+			StageProbe& probe;
+			StageProbe* outer;
+			double startCpu;
+		};
+
+	private:
+
+		StageTotals totals;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		double startCpu;
+
+		std::atomic<bool> tasks = false;
+		std::atomic<double> taskCpuSeconds = 0.0;
+	};
+};
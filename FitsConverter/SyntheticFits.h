@@ -0,0 +1,298 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <fitsio.h>
+
+#include <string>
+#include <string_view>
+#include <span>
+#include <vector>
+#include <algorithm>
+#include <numbers>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <stdexcept>
+
+
+namespace FitsConverter {
+
+	enum class FitsCompression {
+		NONE,
+		RICE,
+		GZIP,
+		HCOMPRESS,
+		PLIO
+	};
+
+	const char* fitsCompressionStr(FitsCompression compression) {
+		switch (compression) {
+		case FitsCompression::NONE: return "none";
+		case FitsCompression::RICE: return "rice";
+		case FitsCompression::GZIP: return "gzip";
+		case FitsCompression::HCOMPRESS: return "hcompress";
+		case FitsCompression::PLIO: return "plio";
+		}
+		return "unknown";
+	}
+
+	//a synthetic sky: a background level with a linear gradient across the image, gaussian noise, and a star field
+	//of gaussian stars whose peaks are spread log uniformly from the noise up to dynamicRange times the noise.
+	//the same spec and seed give the same pixels on every platform, up to the last bit of the math library
+	struct SyntheticFitsSpec {
+
+		std::size_t width = 4096, height = 4096;
+
+		//planes of a NAXIS3 cube; 1 writes a plain 2d image
+		std::size_t depth = 1;
+
+		//8, 16 and 32 store the sky scaled into their range through BSCALE and BZERO
+		int bitpix = FLOAT_IMG;
+
+		std::size_t hdus = 1;
+		FitsCompression compression = FitsCompression::NONE;
+
+		//share of pixels written as undefined: NaN in float images, BLANK in integer ones
+		double nanFraction = 0.0;
+
+		double background = 1000.0;
+
+		//change of the background from one corner of the image to the other, as a fraction of it
+		double gradient = 0.2;
+
+		//standard deviation of the noise
+		double noise = 10.0;
+
+		std::size_t stars = 2000;
+		double dynamicRange = 1e4;
+
+		//standard deviation of a star, in pixels
+		double starSigma = 1.5;
+
+		std::uint64_t seed = 1;
+	};
+
+	//splitmix64, small and identical everywhere, unlike the distributions of <random>
+	class SyntheticRandom {
+	public:
+
+		explicit SyntheticRandom(std::uint64_t seed) : state(seed) {}
+
+		std::uint64_t next() {
+
+			std::uint64_t z = (state += 0x9E3779B97F4A7C15);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+			return z ^ (z >> 31);
+		}
+
+		//uniform in [0, 1)
+		double uniform() { return (next() >> 11) * 0x1.0p-53; }
+
+		//standard normal, by Box-Muller
+		double normal() {
+
+			double u = 1.0 - uniform();
+			return std::sqrt(-2.0 * std::log(u)) * std::cos(2.0 * std::numbers::pi * uniform());
+		}
+
+	private:
+
+		std::uint64_t state;
+	};
+
+	//one stream per row of every plane of every HDU, so that rows can be generated in any order and on any thread
+	std::uint64_t syntheticSeed(std::uint64_t seed, std::size_t hdu, std::size_t plane, std::size_t row) {
+
+		SyntheticRandom random(seed ^ (std::uint64_t(hdu) << 48) ^ (std::uint64_t(plane) << 32) ^ row);
+		return random.next();
+	}
+
+	struct SyntheticStar {
+
+		double x = 0.0, y = 0.0, peak = 0.0;
+	};
+
+	//the stars of one plane, sorted by row
+	std::vector<SyntheticStar> makeSyntheticStars(const SyntheticFitsSpec& spec, std::size_t hdu, std::size_t plane) {
+
+		SyntheticRandom random(syntheticSeed(spec.seed, hdu, plane, std::numeric_limits<std::uint32_t>::max()));
+
+		std::vector<SyntheticStar> stars(spec.stars);
+		for (auto& star : stars) {
+
+			star.x = random.uniform() * spec.width;
+			star.y = random.uniform() * spec.height;
+			star.peak = spec.noise * std::pow(std::max(spec.dynamicRange, 1.0), random.uniform());
+		}
+
+		std::ranges::sort(stars, {}, &SyntheticStar::y);
+		return stars;
+	}
+
+	//the physical range the pixels of spec can take, which integer images are scaled to
+	std::pair<double, double> syntheticRange(const SyntheticFitsSpec& spec) {
+
+		double sky = spec.background * spec.gradient / 2;
+
+		//two bright stars can overlap, noise past 8 sigma is clipped
+		return { spec.background - sky - 8 * spec.noise, spec.background + sky + 8 * spec.noise + 2 * spec.noise * std::max(spec.dynamicRange, 1.0) };
+	}
+
+	//rows firstRow .. firstRow + rows.size() / width of one plane; undefined pixels are set to nullValue
+	void generateSyntheticRows(const SyntheticFitsSpec& spec, std::span<const SyntheticStar> stars, std::size_t hdu, std::size_t plane,
+		std::size_t firstRow, std::span<float> rows, float nullValue) {
+
+		auto [min, max] = syntheticRange(spec);
+		double starRadius = 4 * spec.starSigma;
+		double corners = double(std::max<std::size_t>(spec.width - 1, 1)) + double(std::max<std::size_t>(spec.height - 1, 1));
+
+		for (std::size_t r = 0; r < rows.size() / spec.width; ++r) {
+
+			auto y = firstRow + r;
+			auto row = rows.subspan(r * spec.width, spec.width);
+
+			SyntheticRandom random(syntheticSeed(spec.seed, hdu, plane, y));
+
+			for (std::size_t x = 0; x < spec.width; ++x) {
+
+				double sky = spec.background * (1.0 + spec.gradient * ((x + y) / corners - 0.5));
+				row[x] = float(sky + spec.noise * random.normal());
+			}
+
+			//every star whose disc reaches this row, in the same order whatever the band
+			auto first = std::ranges::lower_bound(stars, y - starRadius, {}, &SyntheticStar::y);
+			for (auto star = first; star != stars.end() && star->y <= y + starRadius; ++star) {
+
+				double dy = y - star->y;
+				auto x0 = std::size_t(std::max(0.0, std::ceil(star->x - starRadius)));
+				auto x1 = std::size_t(std::clamp(std::floor(star->x + starRadius), 0.0, double(spec.width - 1)));
+
+				for (auto x = x0; x <= x1; ++x) {
+
+					double dx = x - star->x;
+					row[x] += float(star->peak * std::exp(-(dx * dx + dy * dy) / (2 * spec.starSigma * spec.starSigma)));
+				}
+			}
+
+			for (auto& pixel : row)
+				pixel = std::clamp<float>(pixel, min, max);
+
+			if (spec.nanFraction > 0.0)
+				for (auto& pixel : row)
+					if (random.uniform() < spec.nanFraction) pixel = nullValue;
+		}
+	}
+
+	//writes spec to fileName, replacing any file there. rows are generated a band at a time on pool,
+	//so the memory used stays at a few bands whatever the size of the image
+	void writeSyntheticFits(const std::string& fileName, const SyntheticFitsSpec& spec, ThreadPool& pool = defaultThreadPool()) {
+
+		switch (spec.bitpix) {
+		case BYTE_IMG: case SHORT_IMG: case LONG_IMG: case FLOAT_IMG: case DOUBLE_IMG: break;
+		default: throw std::runtime_error("unsupported bitpix");
+		}
+		if (spec.width == 0 || spec.height == 0 || spec.depth == 0 || spec.hdus == 0)
+			throw std::runtime_error("empty synthetic image");
+
+		fitsfile* fptr;
+		int status = 0;
+
+		//a leading ! has cfitsio replace an existing file
+		if (fits_create_file(&fptr, ("!" + fileName).c_str(), &status))
+			throw std::runtime_error(std::format("failed to create {}", fileName));
+
+		auto check = [&]() {
+			if (status) {
+
+				char message[FLEN_STATUS];
+				fits_get_errstatus(status, message);
+
+				status = 0;
+				fits_close_file(fptr, &status);
+				throw std::runtime_error(std::format("failed to write {}: {}", fileName, message));
+			}
+		};
+
+		//integer pixels span their whole type but the lowest value, which is kept for BLANK
+		auto [min, max] = syntheticRange(spec);
+		double rawMin = 0.0, rawMax = 0.0;
+		switch (spec.bitpix) {
+		case BYTE_IMG: rawMin = 1; rawMax = 255; break;
+		case SHORT_IMG: rawMin = -32767; rawMax = 32767; break;
+		case LONG_IMG: rawMin = -2147483647.0; rawMax = 2147483647.0; break;
+		}
+		bool integer = spec.bitpix > 0;
+		double bscale = integer ? (max - min) / (rawMax - rawMin) : 1.0;
+		double bzero = integer ? min - rawMin * bscale : 0.0;
+
+		//undefined pixels are passed to cfitsio as this value and written as NaN or BLANK
+		constexpr float nullValue = std::numeric_limits<float>::lowest();
+
+		int compressionType = 0;
+		switch (spec.compression) {
+		case FitsCompression::NONE: break;
+		case FitsCompression::RICE: compressionType = RICE_1; break;
+		case FitsCompression::GZIP: compressionType = GZIP_1; break;
+		case FitsCompression::HCOMPRESS: compressionType = HCOMPRESS_1; break;
+		case FitsCompression::PLIO: compressionType = PLIO_1; break;
+		}
+
+		//about 4MB of floats per band, split between the pool in tasks of a few rows
+		std::size_t bandRows = std::clamp<std::size_t>((1 << 20) / spec.width, 1, spec.height);
+		std::size_t taskRows = std::max<std::size_t>(1, bandRows / (pool.size() * 4));
+		std::vector<float> band(bandRows * spec.width);
+
+		for (std::size_t hdu = 0; hdu < spec.hdus; ++hdu) {
+
+			if (compressionType) fits_set_compression_type(fptr, compressionType, &status);
+
+			LONGLONG naxes[3] = { LONGLONG(spec.width), LONGLONG(spec.height), LONGLONG(spec.depth) };
+			fits_create_imgll(fptr, spec.bitpix, spec.depth > 1 ? 3 : 2, naxes, &status);
+
+			if (integer) {
+
+				fits_write_key(fptr, TDOUBLE, "BSCALE", &bscale, "synthetic sky scaled into the integer range", &status);
+				fits_write_key(fptr, TDOUBLE, "BZERO", &bzero, nullptr, &status);
+				fits_set_bscale(fptr, bscale, bzero, &status);
+
+				if (spec.nanFraction > 0.0) {
+
+					LONGLONG blank = LONGLONG(rawMin) - 1;
+					fits_write_key(fptr, TLONGLONG, "BLANK", &blank, "undefined pixels", &status);
+					fits_set_imgnull(fptr, blank, &status);
+				}
+			}
+
+			check();
+
+			for (std::size_t plane = 0; plane < spec.depth; ++plane) {
+
+				auto stars = makeSyntheticStars(spec, hdu, plane);
+
+				for (std::size_t row = 0; row < spec.height; row += bandRows) {
+
+					auto rows = std::min(bandRows, spec.height - row);
+
+					TaskGroup tasks(pool);
+					for (std::size_t taskRow = 0; taskRow < rows; taskRow += taskRows)
+						tasks.run([&, taskRow]() {
+							auto count = std::min(taskRows, rows - taskRow);
+							generateSyntheticRows(spec, stars, hdu, plane, row + taskRow, std::span(band).subspan(taskRow * spec.width, count * spec.width), nullValue);
+							});
+					tasks.wait();
+
+					LONGLONG firstPixel[3] = { 1, LONGLONG(row) + 1, LONGLONG(plane) + 1 };
+					float null = nullValue;
+					fits_write_pixnullll(fptr, TFLOAT, firstPixel, rows * spec.width, band.data(), spec.nanFraction > 0.0 ? &null : nullptr, &status);
+					check();
+				}
+			}
+		}
+
+		if (fits_close_file(fptr, &status))
+			throw std::runtime_error(std::format("failed to close {}", fileName));
+	}
+};
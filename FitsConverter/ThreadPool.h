@@ -0,0 +1,256 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <exception>
+#include <chrono>
+#include <utility>
+#include <algorithm>
+
+
+namespace FitsConverter {
+
+	//work stealing pool: each worker runs its own deque newest first and steals the oldest tasks of the others.
+	//root tasks are only started by workers with nothing else to run, oldest first, and never by a thread helping in a wait
+	class ThreadPool {
+	public:
+
+		explicit ThreadPool(std::size_t threadCount = std::thread::hardware_concurrency()) {
+
+			threadCount = std::max<std::size_t>(threadCount, 1);
+
+			for (std::size_t i = 0; i < threadCount; ++i)
+				queues.push_back(std::make_unique<Queue>());
+
+			for (std::size_t i = 0; i < threadCount; ++i)
+				threads.emplace_back([this, i]() { workerLoop(i); });
+		}
+
+		~ThreadPool() {
+
+			{
+				std::scoped_lock lock(wakeMutex);
+				stop = true;
+			}
+			wake.notify_all();
+
+			for (auto& thread : threads)
+				thread.join();
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		std::size_t size() const { return threads.size(); }
+
+		void submit(std::function<void()> task) {
+
+			push(std::move(task), false);
+		}
+
+		//for long running tasks that spawn and wait on tasks of their own, such as the files of a batch:
+		//one started inside another's wait would hold that one up until it finished
+		void submitRoot(std::function<void()> task) {
+
+			push(std::move(task), true);
+		}
+
+		//runs one queued task on the calling thread; lets waiting threads help instead of blocking.
+		//root tasks are left to the workers unless includeRoots is set
+		bool runPendingTask(bool includeRoots = false) {
+
+			auto self = currentPool() == this ? currentWorker() : nextQueue++ % queues.size();
+
+			std::function<void()> task;
+			if (!takeTask(self, task, includeRoots)) return false;
+
+			task();
+			return true;
+		}
+
+		//whether the calling thread is one of the workers
+		bool isWorkerThread() const { return currentPool() == this; }
+
+	private:
+
+		struct Queue {
+
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks, rootTasks;
+		};
+
+		static const ThreadPool*& currentPool() {
+
+			thread_local const ThreadPool* pool = nullptr;
+			return pool;
+		}
+		static std::size_t& currentWorker() {
+
+			thread_local std::size_t worker = 0;
+			return worker;
+		}
+
+		void push(std::function<void()> task, bool root) {
+
+			//tasks spawned by a worker stay on its own deque, where they are still hot in its cache
+			auto index = currentPool() == this ? currentWorker() : nextQueue++ % queues.size();
+
+			{
+				std::scoped_lock lock(queues[index]->mutex);
+				(root ? queues[index]->rootTasks : queues[index]->tasks).push_back(std::move(task));
+			}
+			{
+				std::scoped_lock lock(wakeMutex);
+				++pending;
+			}
+			wake.notify_one();
+		}
+
+		bool takeTask(std::size_t self, std::function<void()>& task, bool includeRoots) {
+
+			{
+				auto& own = *queues[self];
+				std::scoped_lock lock(own.mutex);
+				if (!own.tasks.empty()) {
+					task = std::move(own.tasks.back());
+					own.tasks.pop_back();
+				}
+			}
+
+			for (std::size_t i = 1; !task && i < queues.size(); ++i) {
+
+				auto& victim = *queues[(self + i) % queues.size()];
+				std::scoped_lock lock(victim.mutex);
+				if (!victim.tasks.empty()) {
+					task = std::move(victim.tasks.front());
+					victim.tasks.pop_front();
+				}
+			}
+
+			for (std::size_t i = 0; !task && includeRoots && i < queues.size(); ++i) {
+
+				auto& queue = *queues[(self + i) % queues.size()];
+				std::scoped_lock lock(queue.mutex);
+				if (!queue.rootTasks.empty()) {
+					task = std::move(queue.rootTasks.front());
+					queue.rootTasks.pop_front();
+				}
+			}
+
+			if (!task) return false;
+
+			std::scoped_lock lock(wakeMutex);
+			--pending;
+			return true;
+		}
+
+		void workerLoop(std::size_t index) {
+
+			currentPool() = this;
+			currentWorker() = index;
+
+			std::function<void()> task;
+			while (true) {
+
+				if (takeTask(index, task, true)) {
+					task();
+					task = nullptr;
+					continue;
+				}
+
+				std::unique_lock lock(wakeMutex);
+				wake.wait(lock, [&]() { return stop || pending > 0; });
+
+				if (stop && pending == 0) return;
+			}
+		}
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> threads;
+		std::atomic<std::size_t> nextQueue = 0;
+
+		std::mutex wakeMutex;
+		std::condition_variable wake;
+		std::size_t pending = 0;
+		bool stop = false;
+	};
+
+	//a set of tasks that can be waited on together; the first exception thrown by a task is rethrown by wait
+	class TaskGroup {
+	public:
+
+		explicit TaskGroup(ThreadPool& pool) : pool(pool) {}
+
+		~TaskGroup() {
+
+			//tasks reference the caller's stack, so they must finish even when unwinding
+			waitAll();
+		}
+
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup& operator=(const TaskGroup&) = delete;
+
+		void run(std::function<void()> task) {
+
+			++remaining;
+
+			pool.submit([this, task = std::move(task)]() {
+
+				try {
+					task();
+				}
+				catch (...) {
+					std::scoped_lock lock(mutex);
+					if (!error) error = std::current_exception();
+				}
+
+				std::scoped_lock lock(mutex);
+				if (--remaining == 0) done.notify_all();
+				});
+		}
+
+		void wait() {
+
+			waitAll();
+
+			std::scoped_lock lock(mutex);
+			if (error) std::rethrow_exception(std::exchange(error, nullptr));
+		}
+
+	private:
+
+		void waitAll() {
+
+			while (remaining > 0) {
+
+				if (pool.runPendingTask()) continue;
+
+				std::unique_lock lock(mutex);
+				done.wait_for(lock, std::chrono::milliseconds(1), [&]() { return remaining == 0; });
+			}
+
+			//the last task may still hold the mutex it signalled under
+			std::scoped_lock lock(mutex);
+		}
+
+		ThreadPool& pool;
+
+		std::mutex mutex;
+		std::condition_variable done;
+		std::atomic<std::size_t> remaining = 0;
+		std::exception_ptr error;
+	};
+
+	//shared by every conversion that is not given its own pool
+	ThreadPool& defaultThreadPool() {
+
+		static ThreadPool pool;
+		return pool;
+	}
+};
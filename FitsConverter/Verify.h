@@ -0,0 +1,539 @@
+#pragma once
+
+#include "FitsConverter.h"
+#include "SyntheticFits.h"
+
+#include <iostream>
+#include <optional>
+#include <functional>
+#include <filesystem>
+#include <array>
+#include <bit>
+
+
+namespace FitsConverter {
+
+	//the golden output, frozen here as the converter computed it before any simd kernel, table or fused pass existed.
+	//the range, view window, stripe percent and colors are copies rather than calls into the converter,
+	//so a change to the shared functions shows up as a mismatch instead of moving the reference along with it
+
+	//min and max of the pixels that are not NaN, 0 and 0 when there are none
+	std::pair<double, double> referenceRange(std::span<const float> data) {
+
+		float min = std::numeric_limits<float>::max(), max = std::numeric_limits<float>::lowest();
+		bool defined = false;
+
+		for (auto f : data) {
+
+			if (std::isnan(f)) continue;
+
+			if (f < min) min = f;
+			if (f > max) max = f;
+			defined = true;
+		}
+
+		if (!defined) return { 0.0, 0.0 };
+		return { min, max };
+	}
+
+	//the color of a stripe percent, r in the low byte and opaque
+	std::uint32_t referenceColor(ColorizeMode colorMode, double percent) {
+
+		std::uint8_t r = 0, g = 0, b = 0;
+
+		switch (colorMode) {
+		case ColorizeMode::NICKRGB: {
+
+			constexpr std::uint32_t maxValue = { std::numeric_limits<std::uint32_t>::max() >> 8 };
+			std::uint32_t value = maxValue * percent;
+			return value | 0xFF000000;
+		}
+		case ColorizeMode::SHORTNRGB: {
+
+			constexpr std::uint32_t maxValue = { std::numeric_limits<std::uint32_t>::max() >> 16 };
+			std::uint32_t value = maxValue * percent;
+			return value | 0xFF000000;
+		}
+		case ColorizeMode::ROYGBIV: {
+
+			float a = (1.0 - percent) / 0.20;
+			int X = std::floor(a);
+			float Y = std::floor(255.0 * (a - X));
+			switch (X) {
+			case 0: r = 255; g = Y; b = 0; break;
+			case 1: r = 255 - Y; g = 255; b = 0; break;
+			case 2: r = 0; g = 255; b = Y; break;
+			case 3: r = 0; g = 255 - Y; b = 255; break;
+			case 4: r = Y; g = 0; b = 255; break;
+			case 5: r = 255; g = 0; b = 255; break;
+			}
+		} break;
+		case ColorizeMode::GREYSCALE: {
+
+			constexpr std::uint8_t maxValue = { std::numeric_limits<std::uint8_t>::max() };
+			r = g = b = maxValue * percent;
+		} break;
+		case ColorizeMode::BINARY: {
+
+			constexpr std::uint8_t maxValue = { std::numeric_limits<std::uint8_t>::max() };
+			std::uint8_t bit = std::round(percent);
+			r = g = b = maxValue * bit;
+		} break;
+		}
+
+		return std::uint32_t(r) | std::uint32_t(g) << 8 | std::uint32_t(b) << 16 | 0xFF000000;
+	}
+
+	//every pixel through the view window and its stripe, one at a time; dataRange stands in for the range of the pixels
+	void referenceColorize(std::span<const float> data, std::span<uint32_t> converted, ColorizeMode colorMode, double vMin, double vMax, double stripeNum,
+		std::optional<std::pair<double, double>> dataRange = {}) {
+
+		auto [min, max] = dataRange ? *dataRange : referenceRange(data);
+		double distance = max - min;
+
+		double viewMin = min + distance * vMin;
+		double viewMax = min + distance * vMax;
+		double viewDistance = viewMax - viewMin;
+
+		if (viewDistance == 0) viewDistance = 1;
+
+		double stripeDistance = viewDistance / stripeNum;
+
+		for (std::size_t i = 0; i < data.size(); ++i) {
+
+			double f = data[i], percent = 1.0;
+
+			f -= viewMin;
+
+			if (f < viewDistance) {
+				f -= stripeDistance * std::floor(f / stripeDistance);
+
+				percent = f / stripeDistance;
+			}
+
+			//the one change to the baseline: a NaN percent, which it cast to an integer undefined, is the color of NaN pixels,
+			//and the others stay within 0 .. 1
+			if (std::isnan(percent)) percent = 1.0;
+			percent = std::clamp(percent, 0.0, 1.0);
+
+			converted[i] = referenceColor(colorMode, percent);
+		}
+	}
+
+	//value as the big endian bytes a fits file stores it in
+	template<typename Stored>
+	void appendBigEndian(std::vector<std::byte>& bytes, Stored value) {
+
+		auto valueBytes = std::bit_cast<std::array<std::byte, sizeof(Stored)>>(value);
+		if constexpr (std::endian::native == std::endian::little)
+			std::ranges::reverse(valueBytes);
+
+		bytes.insert(bytes.end(), valueBytes.begin(), valueBytes.end());
+	}
+
+	//an input of the golden corpus
+	struct VerifyImage {
+
+		std::string name;
+		std::size_t width = 0, height = 0;
+
+		//the physical values, as a TFLOAT read gives them
+		std::vector<float> pixels;
+
+		//the pixels as the fits file stores them: big endian bitpix values, scaled by bscale and bzero
+		int bitpix = FLOAT_IMG;
+		double bscale = 1.0, bzero = 0.0;
+		std::vector<std::byte> stored;
+
+		//DATAMIN and DATAMAX, fixing the range as a header with both does in streamHdu instead of the pixels giving it
+		std::optional<std::pair<double, double>> dataRange;
+	};
+
+	//odd sizes, so that every simd width, tile and packed byte ends in a tail
+	std::vector<VerifyImage> makeVerifyCorpus(std::size_t width = 263, std::size_t height = 67) {
+
+		std::vector<VerifyImage> corpus;
+		constexpr float nan = std::numeric_limits<float>::quiet_NaN(), inf = std::numeric_limits<float>::infinity();
+
+		auto add = [&](std::string name, auto&& pixel, std::optional<std::pair<double, double>> dataRange = {}) {
+
+			auto& image = corpus.emplace_back(VerifyImage{ std::move(name), width, height, std::vector<float>(width * height), FLOAT_IMG, 1.0, 0.0, {}, dataRange });
+			for (std::size_t i = 0; i < image.pixels.size(); ++i)
+				image.pixels[i] = pixel(i % width, i / width, i);
+		};
+
+		//the sky of FitsGenerator: noise on a gradient, and stars over four decades with a few undefined pixels
+		SyntheticFitsSpec sky;
+		sky.width = width;
+		sky.height = height;
+		sky.stars = 40;
+		sky.nanFraction = 0.01;
+		auto stars = makeSyntheticStars(sky, 0, 0);
+
+		auto& skyImage = corpus.emplace_back(VerifyImage{ "sky", width, height, std::vector<float>(width * height), FLOAT_IMG, 1.0, 0.0, {}, {} });
+		generateSyntheticRows(sky, stars, 0, 0, 0, skyImage.pixels, nan);
+
+		//0 .. 1 with both ends exact, crossing every roygbiv band and stripe boundary
+		add("gradient", [&](auto x, auto y, auto) { return float(x + y) / float(width + height - 2); });
+
+		//only the ends of the range, where percent is exactly 0 or 1
+		add("zero-one", [](auto, auto, auto i) { return float(i % 2); });
+
+		add("nan", [&](auto x, auto y, auto i) { return i % 5 == 0 ? nan : float(x + y) / float(width + height - 2); });
+
+		//infinite ends of the pixels' own range make the view window NaN, so every pixel fails the view test and takes percent 1
+		add("inf", [&](auto x, auto y, auto i) { return i % 7 == 0 ? inf : i % 11 == 0 ? -inf : float(x + y); });
+		add("inf-nan", [](auto, auto, auto i) { return i % 3 == 0 ? inf : i % 3 == 1 ? nan : 0.0f; });
+
+		//a finite range over infinities, as DATAMIN and DATAMAX give: +inf is past the view, while -inf passes the view test
+		//and its stripe offset -inf + inf makes the percent NaN, which every engine must turn into the color of NaN pixels
+		add("inf-range", [&](auto x, auto y, auto i) { return i % 7 == 0 ? inf : i % 11 == 0 ? -inf : float(x + y); },
+			std::make_pair(0.0, double(width + height - 2)));
+		add("inf-nan-range", [](auto, auto, auto i) { return i % 3 == 0 ? inf : i % 3 == 1 ? nan : -inf; }, std::make_pair(-1.0, 1.0));
+
+		//a view distance of 0 falls back to 1
+		add("constant", [](auto, auto, auto) { return 0.5f; });
+		add("zero", [](auto, auto, auto) { return 0.0f; });
+		add("all-nan", [](auto, auto, auto) { return nan; });
+
+		//the largest floats, where the distance only fits in a double, and denormals
+		add("extremes", [](auto, auto, auto i) {
+			constexpr float values[] = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::max(), std::numeric_limits<float>::denorm_min(), -0.0f, 1e-30f };
+			return values[i % std::size(values)];
+			});
+
+		for (auto& image : corpus)
+			for (auto f : image.pixels)
+				appendBigEndian(image.stored, f);
+
+		//an image stored as the type stored returns, its pixels scaled in double precision as cfitsio does for a TFLOAT read
+		auto addStored = [&](std::string name, int bitpix, double bscale, double bzero, auto&& stored) {
+
+			auto& image = corpus.emplace_back(VerifyImage{ std::move(name), width, height, std::vector<float>(width * height), bitpix, bscale, bzero, {}, {} });
+			for (std::size_t i = 0; i < image.pixels.size(); ++i) {
+
+				auto value = stored(i % width, i / width, i);
+				image.pixels[i] = float(value * bscale + bzero);
+				appendBigEndian(image.stored, value);
+			}
+		};
+
+		//every byte, and every short over the whole unsigned range, through their index tables
+		addStored("byte", BYTE_IMG, 0.5, -3.0, [](auto x, auto y, auto)->std::uint8_t { return (x * 3 + y * 5) % 256; });
+		addStored("ushort", SHORT_IMG, 1.0, 32768.0, [](auto, auto, auto i)->std::int16_t { return std::int16_t(i * 97 % 65536 - 32768); });
+		addStored("short", SHORT_IMG, 0.01, -5.0, [](auto x, auto y, auto i)->std::int16_t {
+			return i % 3 == 0 ? (i % 2 ? std::numeric_limits<std::int16_t>::max() : std::numeric_limits<std::int16_t>::lowest()) : std::int16_t(int(x) - int(y) * 4);
+			});
+
+		//the types that decode to floats before colorizing
+		addStored("long", LONG_IMG, 1e-3, 100.0, [](auto, auto, auto i)->std::int32_t {
+			return i % 13 == 0 ? (i % 2 ? std::numeric_limits<std::int32_t>::max() : std::numeric_limits<std::int32_t>::lowest()) : std::int32_t(std::int64_t(i * 7919 % 2000000) - 1000000);
+			});
+		addStored("double", DOUBLE_IMG, 2.0, 1.0, [](auto, auto, auto i)->double { return std::sin(i * 0.001) * 1e5; });
+
+		return corpus;
+	}
+
+	//writes an integer image of the corpus to a fits file, its stored values as they are and BSCALE and BZERO in the header
+	void writeVerifyFits(const VerifyImage& image, const std::string& fileName) {
+
+		fitsfile* fptr = nullptr;
+		int status = 0;
+
+		fits_create_file(&fptr, ("!" + fileName).c_str(), &status);
+		FitsHandle fits(fptr);
+
+		LONGLONG naxes[2] = { LONGLONG(image.width), LONGLONG(image.height) };
+		double bscale = image.bscale, bzero = image.bzero;
+
+		fits_create_imgll(fptr, image.bitpix, 2, naxes, &status);
+		fits_write_key(fptr, TDOUBLE, "BSCALE", &bscale, nullptr, &status);
+		fits_write_key(fptr, TDOUBLE, "BZERO", &bzero, nullptr, &status);
+		fits_set_bscale(fptr, 1.0, 0.0, &status);
+
+		if (image.bitpix == SHORT_IMG) {
+
+			std::vector<std::int16_t> values(image.pixels.size());
+			for (std::size_t i = 0; i < values.size(); ++i)
+				values[i] = std::int16_t(std::uint16_t(image.stored[2 * i]) << 8 | std::uint16_t(image.stored[2 * i + 1]));
+			fits_write_img(fptr, TSHORT, 1, values.size(), values.data(), &status);
+
+		} else
+			fits_write_img(fptr, TBYTE, 1, image.stored.size(), const_cast<std::byte*>(image.stored.data()), &status);
+
+		if (status)
+			throw std::runtime_error(std::format("failed to write {}", fileName));
+	}
+
+	//one colorize case of an engine run: the output of every pixel of image, in order channel order
+	struct VerifyCase {
+
+		const VerifyImage& image;
+		const ImageStats& stats;
+		ColorizeMode colorMode;
+		double vMin, vMax, stripeNum;
+		std::span<uint32_t> converted;
+	};
+
+	//an implementation checked against referenceColorize; run returns false for cases it does not cover
+	struct VerifyEngine {
+
+		std::string name;
+
+		//held to the reference bit for bit, rather than to the tolerance
+		bool exact = true;
+
+		ChannelOrder order = ChannelOrder::RGBA;
+		std::function<bool(const VerifyCase&)> run;
+	};
+
+	std::uint32_t toChannelOrder(ChannelOrder order, std::uint32_t rgba) {
+
+		switch (order) {
+		case ChannelOrder::BGRA: return toChannelOrder<ChannelOrder::BGRA>(rgba);
+		case ChannelOrder::ARGB: return toChannelOrder<ChannelOrder::ARGB>(rgba);
+		default: return rgba;
+		}
+	}
+
+	//every engine the converter can select, at every simd level this cpu runs
+	std::vector<VerifyEngine> makeVerifyEngines() {
+
+		std::vector<VerifyEngine> engines;
+
+		for (auto level : { SimdLevel::SCALAR, SimdLevel::SSE42, SimdLevel::AVX2, SimdLevel::AVX512 }) {
+
+			if (level > detectSimdLevel()) break;
+
+			engines.push_back({ std::format("float {}", simdLevelStr(level)), true, ChannelOrder::RGBA, [level](const VerifyCase& c) {
+				setSimdLevel(level);
+				floatSpaceConvert(c.image.pixels, c.converted, c.stats, c.colorMode, c.vMin, c.vMax, c.stripeNum);
+				return true;
+				} });
+		}
+
+		//the remaining engines run on the widest kernel, which the float engines above tie to the scalar path
+		auto widest = [](auto&& engine) {
+			return [engine](const VerifyCase& c) {
+				setSimdLevel(detectSimdLevel());
+				return engine(c);
+			};
+		};
+
+		auto visitOrder = [&](ChannelOrder order, auto&& function) {
+			switch (order) {
+			case ChannelOrder::BGRA: function.template operator()<ChannelOrder::BGRA>(); break;
+			case ChannelOrder::ARGB: function.template operator()<ChannelOrder::ARGB>(); break;
+			default: function.template operator()<ChannelOrder::RGBA>(); break;
+			}
+		};
+
+		for (auto order : { ChannelOrder::BGRA, ChannelOrder::ARGB })
+			engines.push_back({ order == ChannelOrder::BGRA ? "float bgra" : "float argb", true, order, widest([=](const VerifyCase& c) {
+				visitOrder(order, [&]<ChannelOrder o>() { floatSpaceConvert<o>(c.image.pixels, c.converted, c.stats, c.colorMode, c.vMin, c.vMax, c.stripeNum); });
+				return true;
+				}) });
+
+		//tiles that are no multiple of any vector width
+		constexpr std::size_t oddTile = 999;
+
+		engines.push_back({ "fused", true, ChannelOrder::RGBA, widest([](const VerifyCase& c) {
+			ColorizeVariant variant{ c.colorMode, c.stripeNum, c.converted };
+			floatSpaceConvert(std::span<const float>(c.image.pixels), std::span(&variant, 1), c.stats, c.vMin, c.vMax, 0, oddTile);
+			return true;
+			}) });
+
+		//the memory mapped path: the stored values of every type decoded and scaled a tile at a time, with stats of their own
+		engines.push_back({ "raw", true, ChannelOrder::RGBA, widest([](const VerifyCase& c) {
+			RawImage raw{ c.image.stored, c.image.bitpix, c.image.bscale, c.image.bzero };
+			ColorizeVariant variant{ c.colorMode, c.stripeNum, c.converted };
+			auto stats = computeImageStats(raw);
+			if (c.image.dataRange) std::tie(stats.min, stats.max) = *c.image.dataRange;
+			floatSpaceConvert(raw, std::span(&variant, 1), stats, c.vMin, c.vMax, 0, oddTile);
+			return true;
+			}) });
+
+		//BITPIX 8 and 16 images colorized from their stored values through the color tables of their physical values,
+		//indexed from mapped bytes and read through cfitsio with the scaling overridden
+		engines.push_back({ "integer", true, ChannelOrder::RGBA, widest([](const VerifyCase& c) {
+			if (!isNativeInteger(c.image.bitpix)) return false;
+
+			auto indexed = indexRawImage({ c.image.stored, c.image.bitpix, c.image.bscale, c.image.bzero });
+			ColorizeVariant variant{ c.colorMode, c.stripeNum, c.converted };
+			indexSpaceConvert(indexed, std::span(&variant, 1), computeImageStats(indexed), c.vMin, c.vMax);
+			return true;
+			}) });
+
+		engines.push_back({ "integer file", true, ChannelOrder::RGBA, widest([](const VerifyCase& c) {
+			if (!isNativeInteger(c.image.bitpix)) return false;
+
+			auto fileName = (std::filesystem::temp_directory_path() / "FitsConverterVerify.fits").string();
+			writeVerifyFits(c.image, fileName);
+
+			IndexedImage indexed;
+			{
+				fitsfile* fptr = nullptr;
+				int status = 0;
+
+				fits_open_file(&fptr, fileName.c_str(), READONLY, &status);
+				FitsHandle fits(fptr);
+				if (status)
+					throw std::runtime_error(std::format("failed to open {}", fileName));
+
+				//chunks that end inside rows
+				indexed = readIndexedImage(fptr, c.image.bitpix, c.image.pixels.size(), oddTile);
+			}
+			std::filesystem::remove(fileName);
+
+			ColorizeVariant variant{ c.colorMode, c.stripeNum, c.converted };
+			indexSpaceConvert(indexed, std::span(&variant, 1), computeImageStats(indexed), c.vMin, c.vMax);
+			return true;
+			}) });
+
+		//grey bytes and bits, widened back to the color words they stand for
+		engines.push_back({ "packed", true, ChannelOrder::RGBA, widest([](const VerifyCase& c) {
+			auto format = packedFormat(c.colorMode);
+			if (format == PixelFormat::COLOR32) return false;
+
+			auto width = c.image.width;
+			auto rowBytes = pixelFormatRowBytes(format, width);
+			std::vector<std::uint8_t> packed(rowBytes * c.image.height);
+
+			PackedVariant variant{ c.colorMode, c.stripeNum, packed };
+			packSpaceConvert(std::span<const float>(c.image.pixels), width, std::span(&variant, 1), c.stats, c.vMin, c.vMax);
+
+			for (std::size_t i = 0; i < c.converted.size(); ++i) {
+
+				auto row = std::span(packed).subspan(i / width * rowBytes, rowBytes);
+				std::uint8_t grey = format == PixelFormat::GREY8 ? row[i % width] : (row[i % width / 8] & (0x80 >> (i % width % 8))) ? 255 : 0;
+				c.converted[i] = rgb(grey, grey, grey) | 0xFF000000;
+			}
+			return true;
+			}) });
+
+		//the approximations, held to the tolerance
+		for (auto lutSize : colorizeLutSizes)
+			engines.push_back({ std::format("lut{}", lutSize), false, ChannelOrder::RGBA, widest([lutSize](const VerifyCase& c) {
+				floatSpaceConvert(c.image.pixels, c.converted, c.stats, c.colorMode, c.vMin, c.vMax, c.stripeNum, lutSize);
+				return true;
+				}) });
+
+		engines.push_back({ "quantize", false, ChannelOrder::RGBA, widest([](const VerifyCase& c) {
+			auto indexed = quantizeImage(c.image.pixels, c.stats);
+			ColorizeVariant variant{ c.colorMode, c.stripeNum, c.converted };
+			indexSpaceConvert(indexed, std::span(&variant, 1), c.stats, c.vMin, c.vMax);
+			return true;
+			}) });
+
+		return engines;
+	}
+
+	struct VerifyOptions {
+
+		//no tolerance checks the exact engines only; with one, the approximations are run too
+		//and may differ from the reference by that much in any channel, the exact engines still may not.
+		//nickrgb and snrgb spread one number over their bytes, so any approximation moves their low byte far
+		std::optional<int> tolerance;
+
+		//share of the pixels of a case an approximation may take past the tolerance: a value next to a
+		//stripe edge can land in the neighbouring stripe, at the other end of the color scale
+		double outlierFraction = 0.0;
+
+		std::vector<double> stripes = { 1, 7, 100 };
+		std::vector<std::pair<double, double>> views = { { 0.0, 1.0 }, { 0.25, 0.75 } };
+
+		//differing cases printed per engine
+		std::size_t reportedMismatches = 3;
+	};
+
+	//runs every engine over the corpus in every mode, stripe count and view window and diffs each output
+	//against referenceColorize; the engines get the stats of the converter, the reference finds its own range,
+	//and both take the fixed range of an image that has one.
+	//prints a line per engine and returns whether all of them passed
+	bool verifyEngines(const VerifyOptions& options = {}, std::ostream& out = std::cout) {
+
+		auto corpus = makeVerifyCorpus();
+		auto engines = makeVerifyEngines();
+		auto colorizeModes = { ColorizeMode::GREYSCALE, ColorizeMode::ROYGBIV, ColorizeMode::NICKRGB, ColorizeMode::BINARY, ColorizeMode::SHORTNRGB };
+
+		//the engines switch the simd level, the caller keeps the one it had
+		auto simdLevel = activeSimdLevel().load();
+
+		out << std::format("verifying colorize engines against the reference, {} mode, simd up to {}\n",
+			options.tolerance ? std::format("tolerance {} with {}% outliers", *options.tolerance, 100 * options.outlierFraction) : "exact", simdLevelStr(detectSimdLevel()));
+
+		bool allPassed = true;
+		std::vector<uint32_t> reference, converted;
+
+		for (auto& engine : engines) {
+
+			if (!engine.exact && !options.tolerance) continue;
+
+			int tolerance = engine.exact ? 0 : *options.tolerance;
+			double outlierFraction = engine.exact ? 0.0 : options.outlierFraction;
+			std::size_t cases = 0, failedCases = 0, differingPixels = 0, outlierPixels = 0, pixels = 0;
+			int maxDifference = 0;
+
+			for (auto& image : corpus) {
+
+				auto stats = computeImageStats(image.pixels);
+				if (image.dataRange) std::tie(stats.min, stats.max) = *image.dataRange;
+				reference.resize(image.pixels.size());
+				converted.resize(image.pixels.size());
+
+				for (auto colorizeMode : colorizeModes)
+					for (auto stripeNum : options.stripes)
+						for (auto [vMin, vMax] : options.views) {
+
+							referenceColorize(image.pixels, reference, colorizeMode, vMin, vMax, stripeNum, image.dataRange);
+
+							std::ranges::fill(converted, 0);
+							if (!engine.run({ image, stats, colorizeMode, vMin, vMax, stripeNum, converted })) continue;
+
+							++cases;
+							pixels += converted.size();
+
+							//outliers differ by more than the tolerance, first is the first of them
+							std::size_t differing = 0, outliers = 0, first = 0;
+							int caseDifference = 0;
+
+							for (std::size_t i = 0; i < converted.size(); ++i) {
+
+								auto expected = toChannelOrder(engine.order, reference[i]);
+								if (converted[i] == expected) continue;
+
+								++differing;
+
+								int difference = 0;
+								for (int shift = 0; shift < 32; shift += 8)
+									difference = std::max(difference, std::abs(int(expected >> shift & 0xFF) - int(converted[i] >> shift & 0xFF)));
+								caseDifference = std::max(caseDifference, difference);
+
+								if (difference > tolerance && outliers++ == 0) first = i;
+							}
+
+							differingPixels += differing;
+							outlierPixels += outliers;
+							maxDifference = std::max(maxDifference, caseDifference);
+
+							if (outliers > outlierFraction * converted.size() && failedCases++ < options.reportedMismatches)
+								out << std::format("  {} {} {} stripes {} view {}:{}: {} pixels differ by more than {}, up to {}, first at {} value {} expected {:08x} got {:08x}\n",
+									engine.name, image.name, colorizeModeStr(colorizeMode), stripeNum, vMin, vMax, outliers, tolerance, caseDifference,
+									first, image.pixels[first], toChannelOrder(engine.order, reference[first]), converted[first]);
+						}
+			}
+
+			setSimdLevel(simdLevel);
+
+			bool passed = failedCases == 0;
+			allPassed = allPassed && passed;
+
+			out << std::format("{:<12} {:<5} {:4} cases {:4} failed, {:9.5f}% pixels differ, {:9.5f}% past tolerance, max channel difference {:3}: {}\n",
+				engine.name, engine.exact ? "exact" : "tol", cases, failedCases, pixels ? 100.0 * differingPixels / pixels : 0.0,
+				pixels ? 100.0 * outlierPixels / pixels : 0.0, maxDifference, passed ? "pass" : "FAIL");
+		}
+
+		out << (allPassed ? "all engines match the reference\n" : "engines differ from the reference\n");
+		return allPassed;
+	}
+};
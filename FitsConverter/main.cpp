@@ -2,10 +2,69 @@
 #include <iostream>
 
 #include "FitsConverter.h"
+#include "Benchmark.h"
+#include "Verify.h"
+#include "CommandLine.h"
+#include "BatchConverter.h"
 
-int main(){
+int main(int argc, char* argv[]){
 
-    FitsConverter::readFITSimagesAndColorize(".//spaceimages//conenebula.fits");
+    //a file that cannot be read or written ends the program with its message, as a bad argument does
+    try {
+
+        if (argc > 1 && std::string_view(argv[1]) == "--bench-lut")
+            FitsConverter::benchmarkColorizeLut();
+        else if (argc > 2 && std::string_view(argv[1]) == "--bench-read")
+            FitsConverter::benchmarkRead(argv[2], argc > 3 ? FitsConverter::parseNumber<std::size_t>(argv[3]) : 0);
+        else if (argc > 1 && std::string_view(argv[1]) == "--bench-scaling") {
+
+            //--bench-scaling [max threads [side]]: csv of the strong and weak scaling of the full pipeline
+            FitsConverter::ScalingOptions options;
+            if (argc > 2) options.maxThreads = FitsConverter::parseNumber<std::size_t>(argv[2]);
+            if (argc > 3) options.side = FitsConverter::parseNumber<std::size_t>(argv[3]);
+
+            FitsConverter::benchmarkScaling(options);
+            return 0;
+        }
+        else if (argc > 1 && std::string_view(argv[1]) == "--verify") {
+
+            //--verify [tolerance [outlier fraction]]: exact engines only, or the approximations too
+            FitsConverter::VerifyOptions options;
+            if (argc > 2) options.tolerance = FitsConverter::parseNumber<int>(argv[2]);
+            if (argc > 3) options.outlierFraction = FitsConverter::parseNumber<double>(argv[3]);
+
+            return FitsConverter::verifyEngines(options) ? 0 : 1;
+        }
+        else if (argc > 1) {
+
+            FitsConverter::CommandLine commandLine;
+            try {
+                commandLine = FitsConverter::parseCommandLine(argc, argv);
+            }
+            catch (const std::exception& error) {
+                std::cerr << error.what() << "\n\n" << FitsConverter::commandLineUsage;
+                return 1;
+            }
+
+            if (!commandLine.profileReport.empty())
+                FitsConverter::Profiler::instance().reportPath = commandLine.profileReport;
+
+            if (commandLine.batchInputs.empty())
+                FitsConverter::runConversionJob(commandLine.job);
+            else {
+                auto files = FitsConverter::collectFitsFiles(commandLine.batchInputs, commandLine.batch.recursive);
+                auto report = FitsConverter::runBatch(files, commandLine.job, commandLine.batch);
+                FitsConverter::printBatchReport(report, std::cout);
+                if (!report.failures.empty()) return 1;
+            }
+        }
+        else
+            FitsConverter::readFITSimagesAndColorize(".//spaceimages//conenebula.fits");
+    }
+    catch (const std::exception& error) {
+        std::cerr << error.what() << "\n";
+        return 1;
+    }
 
     std::cout << "\nprogram finished\n";
 }
@@ -0,0 +1,127 @@
+#include <iostream>
+#include <chrono>
+#include <filesystem>
+
+#include "SyntheticFits.h"
+#include "CommandLine.h"
+
+
+namespace FitsConverter {
+
+	constexpr const char* generatorUsage = R"(usage: FitsGenerator <file.fits> [options]
+
+writes a synthetic sky: a background with a gradient, gaussian noise and a star field
+
+  --size <width>x<height>     pixels of every plane (default 4096x4096)
+  --depth <n>                 planes of a NAXIS3 cube, 1 for a 2d image (default 1)
+  --bitpix <8|16|32|-32|-64>  pixel type; integer types are scaled through BSCALE and BZERO (default -32)
+  --hdus <n>                  image HDUs (default 1)
+  --compress <type>           none, rice, gzip, hcompress or plio tile compression (default none)
+  --nan <fraction>            share of undefined pixels, NaN or BLANK (default 0)
+  --background <level>        sky level (default 1000)
+  --gradient <fraction>       change of the sky across the image (default 0.2)
+  --noise <sigma>             noise standard deviation (default 10)
+  --stars <n>                 stars per plane (default 2000)
+  --dynamic-range <ratio>     brightest star peak over the noise (default 10000)
+  --star-sigma <pixels>       star width (default 1.5)
+  --seed <n>                  the same seed writes the same pixels (default 1)
+)";
+
+	FitsCompression parseFitsCompression(std::string_view name) {
+
+		for (auto compression : { FitsCompression::NONE, FitsCompression::RICE, FitsCompression::GZIP, FitsCompression::HCOMPRESS, FitsCompression::PLIO })
+			if (name == fitsCompressionStr(compression)) return compression;
+
+		throw std::runtime_error(std::format("unknown compression: '{}'", name));
+	}
+
+	struct GeneratorCommandLine {
+
+		std::string fileName;
+		SyntheticFitsSpec spec;
+	};
+
+	//the command line as described by generatorUsage, args without the program name
+	GeneratorCommandLine parseGeneratorCommandLine(std::span<const std::string_view> args) {
+
+		GeneratorCommandLine commandLine;
+		auto& spec = commandLine.spec;
+
+		for (std::size_t i = 0; i < args.size(); ++i) {
+
+			auto arg = args[i];
+
+			auto value = [&]() {
+				if (i + 1 == args.size())
+					throw std::runtime_error(std::format("{} needs a value", arg));
+				return args[++i];
+			};
+
+			if (!arg.starts_with("--")) {
+				if (!commandLine.fileName.empty())
+					throw std::runtime_error("more than one fits file given");
+				commandLine.fileName = arg;
+			}
+			else if (arg == "--size") {
+				auto size = splitList(value(), 'x');
+				if (size.size() != 2)
+					throw std::runtime_error(std::format("size is not <width>x<height>: '{}'", args[i]));
+				spec.width = parseNumber<std::size_t>(size[0]);
+				spec.height = parseNumber<std::size_t>(size[1]);
+			}
+			else if (arg == "--depth") spec.depth = parseNumber<std::size_t>(value());
+			else if (arg == "--bitpix") spec.bitpix = parseNumber<int>(value());
+			else if (arg == "--hdus") spec.hdus = parseNumber<std::size_t>(value());
+			else if (arg == "--compress") spec.compression = parseFitsCompression(value());
+			else if (arg == "--nan") spec.nanFraction = parseNumber<double>(value());
+			else if (arg == "--background") spec.background = parseNumber<double>(value());
+			else if (arg == "--gradient") spec.gradient = parseNumber<double>(value());
+			else if (arg == "--noise") spec.noise = parseNumber<double>(value());
+			else if (arg == "--stars") spec.stars = parseNumber<std::size_t>(value());
+			else if (arg == "--dynamic-range") spec.dynamicRange = parseNumber<double>(value());
+			else if (arg == "--star-sigma") spec.starSigma = parseNumber<double>(value());
+			else if (arg == "--seed") spec.seed = parseNumber<std::uint64_t>(value());
+			else
+				throw std::runtime_error(std::format("unknown option: '{}'", arg));
+		}
+
+		if (commandLine.fileName.empty())
+			throw std::runtime_error("no fits file given");
+		if (!(spec.nanFraction >= 0.0 && spec.nanFraction <= 1.0))
+			throw std::runtime_error("--nan takes a fraction from 0 to 1");
+		if (!(spec.starSigma > 0.0))
+			throw std::runtime_error("--star-sigma must be above 0");
+
+		return commandLine;
+	}
+};
+
+int main(int argc, char* argv[]) {
+
+    FitsConverter::GeneratorCommandLine commandLine;
+    try {
+        std::vector<std::string_view> args(argv + 1, argv + argc);
+        commandLine = FitsConverter::parseGeneratorCommandLine(args);
+    }
+    catch (const std::exception& error) {
+        std::cerr << error.what() << "\n\n" << FitsConverter::generatorUsage;
+        return 1;
+    }
+
+    auto& spec = commandLine.spec;
+    auto start = std::chrono::steady_clock::now();
+
+    try {
+        FitsConverter::writeSyntheticFits(commandLine.fileName, spec);
+    }
+    catch (const std::exception& error) {
+        std::cerr << error.what() << "\n";
+        return 1;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << std::format("wrote {}: {} HDUs of {}x{}x{} bitpix {}, {} compression, {:.1f} MB in {:.2f} s\n",
+        commandLine.fileName, spec.hdus, spec.width, spec.height, spec.depth, spec.bitpix, FitsConverter::fitsCompressionStr(spec.compression),
+        std::filesystem::file_size(commandLine.fileName) / 1e6, elapsed.count());
+}